@@ -0,0 +1,53 @@
+//
+// Bump pointer allocation for the many small objects of the compiler
+//
+
+#ifndef BFLANG_ARENA_H
+#define BFLANG_ARENA_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <algorithm>
+#include <new>
+#include <vector>
+
+// Places objects one after another into large blocks. Single objects are never freed, all blocks are freed together
+// by 'release', so the destructors of the objects have to be called before.
+struct Arena {
+    explicit Arena(size_t blockSize = 64 * 1024) : blockSize(blockSize) {}
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+    ~Arena() { release(); }
+
+    void *allocate(size_t size) {
+        const size_t align = alignof(std::max_align_t);
+        size = (size + align - 1) / align * align;
+        if (next == nullptr || size > size_t(end - next)) {
+            // objects larger than a block get a block of their own
+            auto block = static_cast<char*>(std::malloc(std::max(size, blockSize)));
+            if (block == nullptr)
+                throw std::bad_alloc();
+            blocks.push_back(block);
+            next = block;
+            end = block + std::max(size, blockSize);
+        }
+        auto object = next;
+        next += size;
+        return object;
+    }
+
+    // frees all objects at once
+    void release() {
+        for (auto block : blocks)
+            std::free(block);
+        blocks.clear();
+        next = end = nullptr;
+    }
+
+private:
+    size_t blockSize;
+    std::vector<char*> blocks;
+    char *next = nullptr, *end = nullptr;
+};
+
+#endif //BFLANG_ARENA_H
@@ -2,10 +2,16 @@
 #include "print.h"
 #include <assert.h>
 #include <sstream>
+#include <algorithm>
+#include <set>
+#include <typeinfo>
+#include <cmath>
+#include <limits>
+#include <atomic>
+#include <mutex>
+#include <thread>
 
 namespace {
-    int jumpAddressCounter = 0;
-
     std::string parseStringEscape(const std::string &that) {
         std::string str;
 
@@ -68,7 +74,7 @@ namespace {
 
     string result2str(const string &file, int line, const SymbolResolutionResult &result) {
         auto begin = result.dereference(file, line);
-        auto size = result.resolved->getSizeOnTheStack();
+        auto size = result.size();
         return result.name() + "@" + to_string(begin) + ":" + to_string(size);
     }
 
@@ -114,10 +120,19 @@ namespace {
 
     string dereference(const string &file, int line, const SymbolResolutionResult &res) {
         auto asvar = asVariable(file, line, res);
-        string position = to_string(res.dereference(file, line)) + ":" + to_string(asvar->getSizeOnTheStack());
+        string position = to_string(res.dereference(file, line)) + ":" + to_string(res.size());
         return asvar->name + (asvar->temp ? "*" : "") + "@" + position;
     }
 
+    // the variable of an array, that is indexed by 'res'
+    const VariableSymbol *asArray(const string &file, int line, const SymbolResolutionResult &res) {
+        auto var = asVariable(file, line, res);
+        if (!var->isArray || res.elementSize >= 0)
+            die(file, line, EXIT_FAILURE, "Can't index", dereference(file, line, res), "of type",
+                res.elementSize >= 0 ? var->type->name : var->type2str());
+        return var;
+    }
+
     void checkType(const string &file, int line, const VariableSymbol *v1, const VariableSymbol *v2) {
         if (v1->isPointerType != v2->isPointerType)
             die(file, line, EXIT_FAILURE, "Type mismatch between pointer type and non-pointer type", v1->name, "and", v2->name);
@@ -126,7 +141,14 @@ namespace {
     }
 
     void checkType(const string &file, int line, const SymbolResolutionResult &lhs, const SymbolResolutionResult &rhs) {
-        checkType(file, line, asVariable(file, line, lhs), asVariable(file, line, rhs));
+        auto v1 = asVariable(file, line, lhs), v2 = asVariable(file, line, rhs);
+        // an element of an array is a single value of the type of the array
+        if (lhs.elementSize >= 0 || rhs.elementSize >= 0) {
+            if (v1->type != v2->type || (lhs.elementSize < 0 && v1->isPointerType) || (rhs.elementSize < 0 && v2->isPointerType))
+                die(file, line, EXIT_FAILURE, "Type mismatch between", dereference(file, line, lhs), "and", dereference(file, line, rhs));
+            return;
+        }
+        checkType(file, line, v1, v2);
     }
 
     void checkType(const string &file, int line, const SymbolResolutionResult &var, const Symbol *type) {
@@ -134,6 +156,16 @@ namespace {
             die(file, line, EXIT_FAILURE, "Expected variable of type", *type, "but received", *var.resolved);
     }
 
+    // cell, u16 and u32 are numbers, records are not
+    bool isNumber(const CompilationState &state, const TypeSymbol *type) {
+        return type == state.cellType || type == state.u16Type || type == state.u32Type;
+    }
+
+    // number of values of a number type
+    cellValue numberRange(const CompilationState &state, const TypeSymbol *type) {
+        return (cellValue) 1 << (state.cellBits * (int) type->getSizeSumOfChildSymbols());
+    }
+
     string binop2str(BinaryOperatorExpression::OperatorType op) {
         switch (op) {
             case BinaryOperatorExpression::OperatorType::OP_MOV: return "MOV";
@@ -141,102 +173,409 @@ namespace {
             case BinaryOperatorExpression::OperatorType::OP_SUB: return "SUB";
             case BinaryOperatorExpression::OperatorType::OP_MUL: return "MUL";
             case BinaryOperatorExpression::OperatorType::OP_DIV: return "DIV";
+            case BinaryOperatorExpression::OperatorType::OP_MOD: return "MOD";
+            case BinaryOperatorExpression::OperatorType::OP_EQ: return "EQ";
+            case BinaryOperatorExpression::OperatorType::OP_NE: return "NE";
+            case BinaryOperatorExpression::OperatorType::OP_LT: return "LT";
+            case BinaryOperatorExpression::OperatorType::OP_LE: return "LE";
+            case BinaryOperatorExpression::OperatorType::OP_GT: return "GT";
+            case BinaryOperatorExpression::OperatorType::OP_GE: return "GE";
+            case BinaryOperatorExpression::OperatorType::OP_AND: return "AND";
+            case BinaryOperatorExpression::OperatorType::OP_OR: return "OR";
             default:
                 return "";
         }
     }
 
-    std::ostream &movePtr(std::ostream &os, cellValue offset) {
-        return os << std::string(size_t(offset < 0 ? -offset : offset),  offset >= 0 ? '>' : '<');
-    }
+    // Shortest code to add a constant with multiplication loops: 'factor' is added to the target for each unit of a
+    // count in the aux cell, then 'offset'. The count is loaded from its 'digits' in base 'base', most significant
+    // first. Between two digits the count is moved to a second aux cell and multiplied by the base on the way back,
+    // so the code of a wide constant grows with the number of its digits instead of its square root
+    struct ConstantSequence {
+        std::vector<cellValue> digits;
+        cellValue base, factor, offset;
+        // number of '+' and '-' in the sequence, and of the loops between the digits
+        cellValue cost;
+    };
 
-    std::ostream &insertAt(std::ostream &os, cellReference dst, std::string str) {
-        movePtr(os, dst) << str;
-        return movePtr(os, -dst);
+    // multiplication loops for a value of a cell with 'range' values, with more than one digit only if 'nested' is
+    // set. Computed once per value and shared by all emitting threads
+    const ConstantSequence &constantSequence(cellValue value, cellValue range, bool nested) {
+        static std::map<std::tuple<cellValue, cellValue, bool>, ConstantSequence> cache;
+        static std::mutex mutex;
+        std::lock_guard<std::mutex> lock(mutex);
+        auto cached = cache.find(std::make_tuple(range, value, nested));
+        if (cached != cache.end())
+            return cached->second;
+        // the value closest to zero, that wraps to 'value'
+        auto target = value > range / 2 ? value - range : value;
+        ConstantSequence best{{}, 0, 0, 0, std::numeric_limits<cellValue>::max()};
+        auto consider = [&](cellValue a, cellValue b) {
+            cellValue c = (((value - a * b) % range) + range) % range;
+            if (c > range / 2)
+                c -= range;
+            cellValue cost = a + std::abs(b) + std::abs(c);
+            if (cost < best.cost)
+                best = ConstantSequence{{a}, 0, b, c, cost};
+        };
+        // small factors cover all values of 8 bit cells, larger values need factors around their square root
+        auto limit = std::max<cellValue>(64, (cellValue) std::sqrt((double) std::abs(target)) + 2);
+        for (cellValue a = 2; a <= limit; a++) {
+            auto quotient = target / a;
+            if (quotient - 1 < -64)
+                consider(a, quotient - 1);
+            if (quotient < -64)
+                consider(a, quotient);
+            for (cellValue b = -64; a <= 64 && b <= 64; b++) {
+                if (b != 0)
+                    consider(a, b);
+            }
+            if (quotient > 64)
+                consider(a, quotient);
+            if (quotient + 1 > 64)
+                consider(a, quotient + 1);
+        }
+        // the count is the value divided by the base, a step between two digits is '[->+<]>[-<' base '>]<'
+        for (cellValue base = 2; nested && base <= 64; base++) {
+            auto magnitude = std::abs(target), count = (magnitude + base / 2) / base;
+            if (count < base)
+                continue;
+            std::vector<cellValue> digits;
+            for (auto rest = count; rest > 0; rest /= base)
+                digits.insert(digits.begin(), rest % base);
+            auto remainder = magnitude - count * base;
+            cellValue cost = base + std::abs(remainder) + (cellValue) (digits.size() - 1) * (13 + base);
+            for (auto digit : digits)
+                cost += digit;
+            if (cost < best.cost) {
+                cellValue sign = target < 0 ? -1 : 1;
+                best = ConstantSequence{digits, base, sign * base, sign * remainder, cost};
+            }
+        }
+        return cache[std::make_tuple(range, value, nested)] = best;
     }
 
-    std::ostream &zero(std::ostream &os, cellReference dst, cellSize size) {
-        for (int i = 0; i < size; i++)
-            insertAt(os, dst + i, "[-]");
-        return os;
-    }
+    // Writes the brainfuck code of instructions.
+    // The pointer position relative to the current stack base is tracked across instructions, so that the pointer
+    // only returns to the base where the dispatcher needs it. Changes of cell values are collected until a loop or io
+    // depends on them and are then written in the order, that requires the least pointer movement.
+    struct Emitter {
+        struct Change {
+            // if set, the cell is cleared before 'value' is added
+            bool set;
+            cellValue value;
+            // first of 'auxSize' free cells to generate the value with, or -1
+            cellReference aux;
+            cellSize auxSize;
+        };
+
+        std::ostream &os;
+        const CompilationState &state;
+        cellReference position = 0;
+        std::map<cellReference, Change> pending;
+        // cells with a value known from the code written before
+        std::map<cellReference, cellValue> known;
+
+        Emitter(std::ostream &os, const CompilationState &state) : os(os), state(state) {}
+
+        void moveTo(cellReference cell) {
+            os << std::string(size_t(cell < position ? position - cell : cell - position), cell < position ? '<' : '>');
+            position = cell;
+        }
 
-    std::ostream &inc(std::ostream &os, cellReference dst) {
-        return insertAt(os, dst, "+");
-    }
+        cellValue wrap(cellValue value) const {
+            return state.wrap(value);
+        }
 
-    std::ostream &dec(std::ostream &os, cellReference dst) {
-        return insertAt(os, dst, "-");
-    }
+        void plain(cellValue value) {
+            value = wrap(value);
+            os << (value <= state.cellRange() / 2 ? std::string(size_t(value), '+') : std::string(size_t(state.cellRange() - value), '-'));
+        }
 
-    std::ostream &iadd(std::ostream &os, cellReference dst, cellValue value, cellSize size) {
-        assert(size == 1);
-        assert(dst >= 0);
-        insertAt(os, dst, std::string((unsigned long) (value < 0 ? -value : value), value < 0 ? '-' : '+'));
-        return os;
-    }
+        // number of the 'size' cells at aux, that no pending change uses
+        cellSize freeCells(cellReference aux, cellSize size) const {
+            cellSize free = 0;
+            while (aux >= 0 && free < size && pending.count(aux + free) == 0)
+                free++;
+            return free;
+        }
 
-    std::ostream &add(std::ostream &os, cellReference dst, cellReference src, cellSize size) {
-        for (int i = 0; i < size; i++) {
-            insertAt(os, src + i, "[");
-            dec(os, src + i);
-            inc(os, dst + i);
-            insertAt(os, src + i, "]");
+        // whether 'cell' holds zero
+        bool isZero(cellReference cell) const {
+            auto k = known.find(cell);
+            return k != known.end() && k->second == 0;
         }
-        return os;
-    }
 
-    std::ostream &add(std::ostream &os, cellReference dst, cellReference src, cellReference aux, cellSize size) {
-        zero(os, aux, 1);
-        for (int i = 0; i < size; i++) {
-            insertAt(os, src + i, "[");
-            dec(os, src + i);
-            inc(os, dst + i);
-            inc(os, aux);
-            insertAt(os, src + i, "]");
-            add(os, src + i, aux, 1);
+        // length of the code to add 'value' to 'cell' with 'free' cells at aux
+        cellValue constantCost(cellReference cell, cellValue value, cellReference aux, cellSize free) const {
+            value = wrap(value);
+            cellValue cost = std::min(value, state.cellRange() - value);
+            if (free > 0) {
+                auto &seq = constantSequence(value, state.cellRange(), free > 1);
+                int clear = (isZero(aux) ? 0 : 3) + (seq.digits.size() > 1 && !isZero(aux + 1) ? 5 : 0);
+                cost = std::min(cost, seq.cost + 4 * std::abs(aux - cell) + 3 + clear);
+            }
+            return cost;
         }
-        return os;
-    }
 
-    std::ostream &sub(std::ostream &os, cellReference dst, cellReference src, cellSize size) {
-        for (int i = 0; i < size; i++) {
-            insertAt(os, src + i, "[");
-            dec(os, src + i);
-            dec(os, dst + i);
-            insertAt(os, src + i, "]");
+        // adds 'value' to the cell at the pointer, using multiplication loops on 'free' cells at aux if that is shorter
+        void addConstant(cellValue value, cellReference aux, cellSize free) {
+            auto cell = position;
+            value = wrap(value);
+            if (constantCost(cell, value, aux, free) >= std::min(value, state.cellRange() - value)) {
+                plain(value);
+                return;
+            }
+            auto &seq = constantSequence(value, state.cellRange(), free > 1);
+            if (seq.digits.size() > 1 && !isZero(aux + 1)) {
+                moveTo(aux + 1);
+                os << "[-]";
+            }
+            moveTo(aux);
+            if (!isZero(aux))
+                os << "[-]";
+            plain(seq.digits[0]);
+            for (size_t d = 1; d < seq.digits.size(); d++) {
+                os << "[-";
+                moveTo(aux + 1);
+                os << '+';
+                moveTo(aux);
+                os << ']';
+                moveTo(aux + 1);
+                os << "[-";
+                moveTo(aux);
+                plain(seq.base);
+                moveTo(aux + 1);
+                os << ']';
+                moveTo(aux);
+                plain(seq.digits[d]);
+            }
+            os << '[';
+            moveTo(cell);
+            plain(seq.factor);
+            moveTo(aux);
+            os << "-]";
+            known[aux] = 0;
+            if (seq.digits.size() > 1)
+                known[aux + 1] = 0;
+            moveTo(cell);
+            plain(seq.offset);
         }
-        return os;
-    }
 
-    std::ostream &sub(std::ostream &os, cellReference dst, cellReference src, cellReference aux, cellSize size) {
-        zero(os, aux, 1);
-        for (int i = 0; i < size; i++) {
-            insertAt(os, src + i, "[");
-            dec(os, src + i);
-            dec(os, dst + i);
-            inc(os, aux);
-            insertAt(os, src + i, "]");
-            add(os, src + i, aux, 1);
+        void write(cellReference cell, const Change &change) {
+            moveTo(cell);
+            auto k = known.find(cell);
+            auto free = freeCells(change.aux, change.auxSize);
+            if (change.set) {
+                if (k != known.end() && constantCost(cell, change.value - k->second, change.aux, free) <= 3 + constantCost(cell, change.value, change.aux, free)) {
+                    addConstant(change.value - k->second, change.aux, free);
+                } else {
+                    os << "[-]";
+                    addConstant(change.value, change.aux, free);
+                }
+                known[cell] = wrap(change.value);
+            } else {
+                addConstant(change.value, change.aux, free);
+                if (k != known.end())
+                    k->second = wrap(k->second + change.value);
+            }
         }
-        return os;
-    }
 
-    std::ostream &foreach(std::ostream &os, cellReference dst, cellSize size, std::string op) {
-        for (int i = 0; i < size; ++i)
-            insertAt(os, dst + i, op);
-        return os;
-    }
+        // writes all pending changes, visiting the cells in the order that ends closest to 'next'
+        void flush(cellReference next) {
+            if (pending.empty())
+                return;
+            auto lo = pending.begin()->first, hi = pending.rbegin()->first;
+            auto leftFirst = std::abs(position - lo) + std::abs(next - hi);
+            auto rightFirst = std::abs(position - hi) + std::abs(next - lo);
+            if (leftFirst <= rightFirst)
+                for (auto &c : pending) write(c.first, c.second);
+            else
+                for (auto c = pending.rbegin(); c != pending.rend(); ++c) write(c->first, c->second);
+            pending.clear();
+        }
+
+        // moves the stack base by 'offset' cells
+        void rebase(cellReference offset) {
+            position -= offset;
+            std::map<cellReference, Change> moved;
+            for (auto &c : pending)
+                moved[c.first - offset] = Change{c.second.set, c.second.value, c.second.aux < 0 ? -1 : c.second.aux - offset, c.second.auxSize};
+            pending.swap(moved);
+            std::map<cellReference, cellValue> movedKnown;
+            for (auto &k : known)
+                movedKnown[k.first - offset] = k.second;
+            known.swap(movedKnown);
+        }
+
+        // writes code, that depends on the current value of 'cell'
+        void at(cellReference cell, const std::string &code) {
+            flush(cell);
+            moveTo(cell);
+            os << code;
+            for (char c : code) {
+                if (c == '[') {
+                    // the loop body may run any number of times
+                    known.clear();
+                } else if (c == ']') {
+                    known.clear();
+                    known[cell] = 0;
+                } else if (c == ',') {
+                    known.erase(cell);
+                }
+            }
+        }
+
+        void zero(cellReference dst, cellSize size) {
+            for (int i = 0; i < size; i++)
+                pending[dst + i] = Change{true, 0, -1, 0};
+        }
+
+        void iadd(cellReference dst, cellValue value, cellReference aux = -1, cellSize auxSize = 1) {
+            assert(dst >= 0);
+            auto c = pending.find(dst);
+            if (c == pending.end()) {
+                pending[dst] = Change{false, value, aux, aux >= 0 ? auxSize : 0};
+            } else {
+                c->second.value += value;
+                if (aux >= 0) {
+                    c->second.aux = aux;
+                    c->second.auxSize = auxSize;
+                }
+            }
+        }
+
+        void inc(cellReference dst) { iadd(dst, 1); }
+
+        void dec(cellReference dst) { iadd(dst, -1); }
+
+        // writes a loop on 'cell', whose body only changes 'cell' and the cells in 'touched'
+        template<typename Body>
+        void loop(cellReference cell, std::initializer_list<cellReference> touched, Body body) {
+            flush(cell);
+            // values of the other cells survive the loop
+            auto outside = known;
+            outside.erase(cell);
+            for (auto c : touched)
+                outside.erase(c);
+            at(cell, "[");
+            body();
+            at(cell, "]");
+            known.insert(outside.begin(), outside.end());
+        }
+
+        // adds (or subtracts if 'sign' is -1) 'size' cells from src to dst and clears src
+        void transfer(cellReference dst, cellReference src, cellSize size, cellValue sign = 1) {
+            for (int i = 0; i < size; i++) {
+                loop(src + i, {dst + i}, [&] {
+                    dec(src + i);
+                    iadd(dst + i, sign);
+                });
+            }
+        }
+
+        // adds (or subtracts if 'sign' is -1) 'size' cells from src to dst, using the auxiliary cell aux
+        void copy(cellReference dst, cellReference src, cellReference aux, cellSize size, cellValue sign = 1) {
+            zero(aux, 1);
+            for (int i = 0; i < size; i++) {
+                loop(src + i, {dst + i, aux}, [&] {
+                    dec(src + i);
+                    iadd(dst + i, sign);
+                    inc(aux);
+                });
+                transfer(src + i, aux, 1);
+            }
+        }
+
+        // Counts 'counter' down and adds (or subtracts if 'sign' is -1) each unit to a in 'a 1 0 c'. c is incremented
+        // each time a wraps around. A unit is added and then tested for zero, or tested for zero and then subtracted.
+        void carryLoop(cellReference counter, cellReference a, cellValue sign) {
+            loop(counter, {a, a + 1, a + 2, a + 3}, [&] {
+                dec(counter);
+                at(a, carryStep(sign));
+            });
+        }
+
+        static std::string carryStep(cellValue sign) {
+            return sign > 0 ? "+[>-]>[>>+<<->]<+<" : "[>-]>[>>+<<->]<+<-";
+        }
+
+        // adds (or subtracts if 'sign' is -1) the number of 'size' cells at src to the one at dst, lowest cell first.
+        // aux holds 'a 1 0 c k': each cell of dst is moved to a, where src and the carry k of the lower cell are
+        // added. src is cleared, and the carry out of the highest cell is left in c if 'carryOut' is set.
+        void carry(cellReference dst, cellReference src, cellSize size, cellReference aux, cellValue sign, bool carryOut) {
+            auto a = aux, c = aux + 3, k = aux + 4;
+            zero(aux, 5);
+            inc(aux + 1);
+            for (int i = 0; i < size; i++) {
+                if (i == size - 1 && !carryOut) {
+                    transfer(dst + i, src + i, 1, sign);
+                    transfer(dst + i, c, 1, sign);
+                    break;
+                }
+                transfer(a, dst + i, 1);
+                if (i > 0)
+                    transfer(k, c, 1);
+                carryLoop(src + i, a, sign);
+                if (i > 0)
+                    carryLoop(k, a, sign);
+                transfer(dst + i, a, 1);
+            }
+            dec(aux + 1);
+        }
+
+        void foreach(cellReference dst, cellSize size, const std::string &op) {
+            for (int i = 0; i < size; ++i)
+                at(dst + i, op);
+        }
+
+        // writes code of the dispatcher, that expects the pointer at 'cell'
+        void dispatch(cellReference cell, const std::string &code) {
+            flush(cell);
+            moveTo(cell);
+            os << code;
+            known.clear();
+        }
+
+        // writes code, that starts at 'cell' and walks to 'end' over a distance only known at runtime. The walk stops
+        // on a zero
+        void walk(cellReference cell, cellReference end, const std::string &code) {
+            flush(cell);
+            moveTo(cell);
+            os << code;
+            position = end;
+            known.clear();
+            known[end] = 0;
+        }
+
+        // code, that moves the pointer by 'offset'
+        static std::string step(cellReference offset) {
+            return std::string(size_t(std::abs(offset)), offset < 0 ? '<' : '>');
+        }
+
+        // code, that adds the cell 'from' to the cell 'to' and clears it, both relative to the pointer
+        static std::string shift(cellReference from, cellReference to) {
+            return step(from) + "[-" + step(to - from) + "+" + step(from - to) + "]" + step(-from);
+        }
+
+        void emit(const Instruction &i);
+    };
 
-    void outputInstruction(Instruction &i) {
-        osprintln(intermediate_output_stream, i);
-        i.release = true;
-        osprintln(binary_output_stream, i);
+    void outputInstruction(CompilationState &state, Instruction &i) {
+        if (state.currentCode == nullptr)
+            die(i.file, i.line, EXIT_FAILURE, "Instruction outside of a function");
+        if (i.instr == InstructionName::LABEL)
+            state.reachable = true;
+        // code after a jump, e.g. after a tail call, is never executed
+        if (state.reachable)
+            state.currentCode->push_back(i);
+        if (i.instr == InstructionName::JUMP || i.instr == InstructionName::TEST || i.instr == InstructionName::RET)
+            state.reachable = false;
     }
 
-    void outputIntegerInstruction(const std::string &file, int line,
+    void outputIntegerInstruction(const std::string &file, int line, CompilationState &state,
                                   BinaryOperatorExpression::OperatorType op,
-                                  const SymbolResolutionResult &lhs, cellValue integer) {
+                                  const SymbolResolutionResult &lhs, cellValue integer, cellReference aux = -1) {
         InstructionName instructionName = InstructionName::UNINITIALIZED;
         switch (op) {
             case BinaryOperatorExpression::OP_MOV:
@@ -248,26 +587,77 @@ namespace {
             default:
                 die(file, line, EXIT_FAILURE, "Invalid operation");
         }
+        // the cells after the end of the current frame are always free to generate the constant in
+        if (aux < 0)
+            aux = (int) state.symbolTable.currentScope()->getCurrentAddressOfFunctionStackframeEnd();
+        auto size = (int) lhs.size();
+        if (size > 1) {
+            // numbers of several cells are loaded cell by cell, additions carry into the next cell
+            auto range = (cellValue) 1 << (state.cellBits * size);
+            auto value = (((op == BinaryOperatorExpression::OP_SUB ? -integer : integer) % range) + range) % range;
+            if (op != BinaryOperatorExpression::OP_MOV) {
+                Instruction i(file, line, InstructionName::IADD_CARRY, dereference(file, line, lhs) + " " + to_string(integer));
+                i.constant.dst = (int) lhs.dereference(file, line);
+                // large values are subtracted
+                i.constant.value = value > range / 2 ? value - range : value;
+                i.constant.size = size;
+                i.constant.aux = aux;
+                outputInstruction(state, i);
+                return;
+            }
+            for (int c = 0; c < size; c++, value /= state.cellRange()) {
+                Instruction i(file, line, InstructionName::ILOAD,
+                              dereference(file, line, lhs) + "+" + to_string(c) + " " + to_string(value % state.cellRange()));
+                i.constant.dst = (int) lhs.dereference(file, line) + c;
+                i.constant.value = value % state.cellRange();
+                i.constant.size = 1;
+                i.constant.aux = aux;
+                outputInstruction(state, i);
+            }
+            return;
+        }
         Instruction i(file, line, instructionName, dereference(file, line, lhs) + " " + to_string(integer));
         i.constant.dst = (int) lhs.dereference(file, line);
         i.constant.value = instructionName == InstructionName::ISUB ? -integer : integer;
-        i.constant.size = (int) lhs.resolved->getSizeOnTheStack();
-        if (i.constant.size != 1)
-            die(file, line, EXIT_SUCCESS, "Invalid assign of integer to variable of size", i.constant.size);
-        outputInstruction(i);
+        i.constant.size = size;
+        i.constant.aux = aux;
+        outputInstruction(state, i);
+    }
+
+    // cells needed to convert a cell value from or to decimal digits
+    cellSize decimalScratchSize(const CompilationState &state, IOStatement::IOFunction function) {
+        if (function == IOStatement::IOFunction::IODECIMALINPUT)
+            return 9;
+        // a zero marker, a cell for each digit of the largest value and the division loop
+        return (cellSize) std::to_string(state.cellRange() - 1).size() + 6;
     }
 
-    void outputIoInstruction(const std::string &file, int line, IOStatement::IOFunction function,
-                             const SymbolResolutionResult &dst) {
-        Instruction i(file, line, function == IOStatement::IOFunction::IOINPUT ? InstructionName::WRITE_INPUT
-                                                                               : InstructionName::WRITE_OUTPUT,
-                      result2str(file, line, dst));
+    void outputIoInstruction(const std::string &file, int line, CompilationState &state,
+                             IOStatement::IOFunction function,
+                             const SymbolResolutionResult &dst, cellReference aux = -1) {
+        InstructionName instructionName = InstructionName::UNINITIALIZED;
+        switch (function) {
+            case IOStatement::IOFunction::IOINPUT:
+                instructionName = InstructionName::WRITE_INPUT; break;
+            case IOStatement::IOFunction::IOOUTPUT:
+                instructionName = InstructionName::WRITE_OUTPUT; break;
+            case IOStatement::IOFunction::IODECIMALINPUT:
+                instructionName = InstructionName::WRITE_DECIMAL_INPUT; break;
+            case IOStatement::IOFunction::IODECIMALOUTPUT:
+                instructionName = InstructionName::WRITE_DECIMAL_OUTPUT; break;
+        }
+        Instruction i(file, line, instructionName, result2str(file, line, dst));
         i.io.src = (int) dst.dereference(file, line);
-        i.io.size = (int) dst.resolved->getSizeOnTheStack();
-        outputInstruction(i);
+        i.io.size = (int) dst.size();
+        i.io.aux = aux;
+        i.io.size_aux = aux >= 0 ? decimalScratchSize(state, function) : 0;
+        if (aux >= 0 && i.io.size != 1)
+            die(file, line, EXIT_FAILURE, "Decimal io is only implemented for variables of size 1");
+        outputInstruction(state, i);
     }
 
-    void outputMoveInstruction(const std::string &file, int line, BinaryOperatorExpression::OperatorType op,
+    void outputMoveInstruction(const std::string &file, int line, CompilationState &state,
+                               BinaryOperatorExpression::OperatorType op,
                                const SymbolResolutionResult &lhs, const SymbolResolutionResult &rhs) {
         if (lhs != rhs) {
             checkType(file, line, lhs, rhs);
@@ -286,12 +676,13 @@ namespace {
                           dereference(file, line, lhs) + " " + dereference(file, line, rhs));
             i.move.dst = (int) lhs.dereference(file, line);
             i.move.src = (int) rhs.dereference(file, line);
-            i.move.size = (int) lhs.resolved->getSizeOnTheStack();
-            outputInstruction(i);
+            i.move.size = (int) lhs.size();
+            outputInstruction(state, i);
         }
     }
 
-    void outputCopyInstruction(const std::string &file, int line, BinaryOperatorExpression::OperatorType op,
+    void outputCopyInstruction(const std::string &file, int line, CompilationState &state,
+                               BinaryOperatorExpression::OperatorType op,
                                const SymbolResolutionResult &lhs, const SymbolResolutionResult &rhs,
                                const SymbolResolutionResult &aux) {
         if (lhs != rhs) {
@@ -311,66 +702,200 @@ namespace {
             i.copy.dst = (int) lhs.dereference(file, line);
             i.copy.src = (int) rhs.dereference(file, line);
             i.copy.aux = (int) aux.dereference(file, line);
-            i.copy.size = (int) lhs.resolved->getSizeOnTheStack();
-            i.copy.size_aux = (int) aux.resolved->getSizeOnTheStack();
-            outputInstruction(i);
+            i.copy.size = (int) lhs.size();
+            i.copy.size_aux = (int) aux.size();
+            outputInstruction(state, i);
+        }
+    }
+
+    void outputArithmeticInstruction(const std::string &file, int line, CompilationState &state,
+                                     BinaryOperatorExpression::OperatorType op,
+                                     const SymbolResolutionResult &lhs, const SymbolResolutionResult &rhs,
+                                     const SymbolResolutionResult &aux, bool remainder = false) {
+        checkType(file, line, lhs, rhs);
+        InstructionName instructionName = InstructionName::UNINITIALIZED;
+        switch (op) {
+            case BinaryOperatorExpression::OP_MUL:
+                instructionName = InstructionName::MUL; break;
+            case BinaryOperatorExpression::OP_DIV:
+                // the remainder is kept in the cell after lhs
+                instructionName = remainder ? InstructionName::DIVMOD : InstructionName::DIV; break;
+            case BinaryOperatorExpression::OP_MOD:
+                instructionName = InstructionName::MOD; break;
+            default:
+                die(file, line, EXIT_FAILURE, "Invalid operation");
         }
+        Instruction i(file, line, instructionName,
+                      dereference(file, line, lhs) + " " + dereference(file, line, rhs) + " " + dereference(file, line, aux));
+        i.copy.dst = (int) lhs.dereference(file, line);
+        i.copy.src = (int) rhs.dereference(file, line);
+        i.copy.aux = (int) aux.dereference(file, line);
+        i.copy.size = (int) lhs.size();
+        i.copy.size_aux = (int) aux.size();
+        if (i.copy.size != 1)
+            die(file, line, EXIT_FAILURE, "Operator", binop2str(op), "is only implemented for variables of size 1");
+        outputInstruction(state, i);
     }
 
-    void outputCopyInstruction(const std::string &file, int line, cellReference lhs, cellReference rhs, cellReference aux) {
+    void outputArithmeticInstruction(const std::string &file, int line, CompilationState &state,
+                                     BinaryOperatorExpression::OperatorType op,
+                                     const SymbolResolutionResult &lhs, cellValue integer,
+                                     const SymbolResolutionResult &aux, bool remainder = false) {
+        InstructionName instructionName = InstructionName::UNINITIALIZED;
+        switch (op) {
+            case BinaryOperatorExpression::OP_MUL:
+                instructionName = InstructionName::IMUL; break;
+            case BinaryOperatorExpression::OP_DIV:
+                instructionName = remainder ? InstructionName::IDIVMOD : InstructionName::IDIV; break;
+            case BinaryOperatorExpression::OP_MOD:
+                instructionName = InstructionName::IMOD; break;
+            default:
+                die(file, line, EXIT_FAILURE, "Invalid operation");
+        }
+        Instruction i(file, line, instructionName,
+                      dereference(file, line, lhs) + " " + to_string(integer) + " " + dereference(file, line, aux));
+        i.constant.dst = (int) lhs.dereference(file, line);
+        i.constant.value = integer;
+        i.constant.size = (int) lhs.size();
+        i.constant.aux = (int) aux.dereference(file, line);
+        if (i.constant.size != 1)
+            die(file, line, EXIT_FAILURE, "Operator", binop2str(op), "is only implemented for variables of size 1");
+        outputInstruction(state, i);
+    }
+
+    void outputRelationInstruction(const std::string &file, int line, CompilationState &state,
+                                   BinaryOperatorExpression::OperatorType op,
+                                   const SymbolResolutionResult &lhs, const SymbolResolutionResult &rhs,
+                                   const SymbolResolutionResult &aux) {
+        checkType(file, line, lhs, rhs);
+        InstructionName instructionName = InstructionName::UNINITIALIZED;
+        switch (op) {
+            case BinaryOperatorExpression::OP_LT:
+                instructionName = InstructionName::LT; break;
+            case BinaryOperatorExpression::OP_LE:
+                instructionName = InstructionName::LE; break;
+            case BinaryOperatorExpression::OP_GT:
+                instructionName = InstructionName::GT; break;
+            case BinaryOperatorExpression::OP_GE:
+                instructionName = InstructionName::GE; break;
+            case BinaryOperatorExpression::OP_EQ:
+                instructionName = InstructionName::EQ; break;
+            case BinaryOperatorExpression::OP_NE:
+                instructionName = InstructionName::NE; break;
+            default:
+                die(file, line, EXIT_FAILURE, "Invalid operation");
+        }
+        Instruction i(file, line, instructionName,
+                      dereference(file, line, lhs) + " " + dereference(file, line, rhs) + " " + dereference(file, line, aux));
+        i.copy.dst = (int) lhs.dereference(file, line);
+        i.copy.src = (int) rhs.dereference(file, line);
+        i.copy.aux = (int) aux.dereference(file, line);
+        i.copy.size = (int) lhs.size();
+        i.copy.size_aux = (int) aux.size();
+        outputInstruction(state, i);
+    }
+
+    // adds or subtracts numbers of several cells with a carry between the cells, and clears rhs
+    void outputCarryInstruction(const std::string &file, int line, CompilationState &state,
+                                BinaryOperatorExpression::OperatorType op,
+                                const SymbolResolutionResult &lhs, const SymbolResolutionResult &rhs,
+                                const SymbolResolutionResult &aux) {
+        checkType(file, line, lhs, rhs);
+        Instruction i(file, line, op == BinaryOperatorExpression::OP_ADD ? InstructionName::ADD_CARRY : InstructionName::SUB_CARRY,
+                      dereference(file, line, lhs) + " " + dereference(file, line, rhs) + " " + dereference(file, line, aux));
+        i.copy.dst = (int) lhs.dereference(file, line);
+        i.copy.src = (int) rhs.dereference(file, line);
+        i.copy.aux = (int) aux.dereference(file, line);
+        i.copy.size = (int) lhs.size();
+        i.copy.size_aux = (int) aux.size();
+        outputInstruction(state, i);
+    }
+
+    void outputMoveInstruction(const std::string &file, int line, CompilationState &state,
+                               cellReference lhs, cellReference rhs) {
+        Instruction i(file, line, InstructionName::MOVE, to_string(lhs) + ", " + to_string(rhs));
+        i.move.dst = lhs;
+        i.move.src = rhs;
+        i.move.size = 1;
+        outputInstruction(state, i);
+    }
+
+    void outputCopyInstruction(const std::string &file, int line, CompilationState &state,
+                               cellReference lhs, cellReference rhs, cellReference aux) {
         Instruction i(file, line, InstructionName::COPY, to_string(lhs) + ", " + to_string(rhs) + ", " + to_string(aux));
         i.copy.aux = aux;
         i.copy.size_aux = 1;
         i.copy.dst = lhs;
         i.copy.src = rhs;
         i.copy.size = 1;
-        outputInstruction(i);
+        outputInstruction(state, i);
     }
 
-    void outputAutoMoveInstruction(const std::string &file, int line, SymbolTable &symbolTable,
+    void outputAutoMoveInstruction(const std::string &file, int line, CompilationState &state,
                                    BinaryOperatorExpression::OperatorType op, const SymbolResolutionResult &lhs,
                                    const SymbolResolutionResult &rhs) {
         if (lhs != rhs) {
             checkType(file, line, lhs, rhs);
-            if (rhs.resolved->temp) {
-                // rhs is temporary and can be safely destroyed
-                outputMoveInstruction(file, line, op, lhs, rhs);
+            auto type = asVariable(file, line, lhs)->type;
+            if (op != BinaryOperatorExpression::OP_MOV && lhs.size() > 1) {
+                // u16 and u32 carry into the next cell, the rhs is consumed by the addition
+                state.symbolTable.push(*state.symbolTable.newTmpStackframe(line));
+                auto value = rhs;
+                if (!rhs.resolved->temp && !rhs.lastUse) {
+                    value = state.symbolTable.newTmpVariable(line, type);
+                    auto aux = state.symbolTable.newTmpVariable(line, type);
+                    outputCopyInstruction(file, line, state, BinaryOperatorExpression::OP_MOV, value, rhs, aux);
+                    state.symbolTable.release(aux);
+                }
+                auto scratch = state.symbolTable.newTmpVariable(line, state.cellType, 5, "__scratch");
+                outputCarryInstruction(file, line, state, op, lhs, value, scratch);
+                state.symbolTable.release(value);
+                state.symbolTable.pop();
+                return;
+            }
+            if (rhs.resolved->temp || rhs.lastUse) {
+                // rhs is temporary or not read again and can be safely destroyed, it may already be located in the cells of lhs
+                if (op != BinaryOperatorExpression::OP_MOV || lhs.dereference(file, line) != rhs.dereference(file, line))
+                    outputMoveInstruction(file, line, state, op, lhs, rhs);
+                state.symbolTable.release(rhs);
             } else {
                 // todo: pop old stackframe (because rhs is not a tmp, it can't be contained in that scope), create new stack, add variable, pop?
-                symbolTable.push(*symbolTable.newTmpStackframe(line));
-                auto aux = symbolTable.newTmpVariable(line, asVariable(file, line, lhs)->type);
-                outputCopyInstruction(file, line, op, lhs, rhs, aux);
-                symbolTable.pop();
+                state.symbolTable.push(*state.symbolTable.newTmpStackframe(line));
+                auto aux = state.symbolTable.newTmpVariable(line, type);
+                outputCopyInstruction(file, line, state, op, lhs, rhs, aux);
+                state.symbolTable.pop();
             }
         }
     }
 
-    void outputStackInstruction(const std::string &file, int line, bool isPop, cellValue offset, std::string comment = "") {
+    void outputStackInstruction(const std::string &file, int line, CompilationState &state,
+                                bool isPop, cellValue offset, std::string comment = "") {
         Instruction i(file, line, isPop ? InstructionName::POP_STACK : InstructionName::PUSH_STACK, comment);
         i.stack.offset = offset;
         if (offset != 0)
-            outputInstruction(i);
+            outputInstruction(state, i);
     }
 
-    void outputLabelInstruction(const std::string &file, int line, cellValue offset, label label, std::string comment) {
+    void outputLabelInstruction(const std::string &file, int line, CompilationState &state,
+                                cellValue offset, label label, std::string comment) {
         Instruction i(file, line, InstructionName::LABEL, comment + "@" + to_string(label));
         i.label.address = label;
-        outputInstruction(i);
-        outputStackInstruction(file, line, true, offset);
+        outputInstruction(state, i);
+        outputStackInstruction(file, line, state, true, offset);
     }
 
-    void outputCompareInstruction(const std::string &file, int line, cellReference isZero, cellReference notZero, cellReference condition, cellSize size) {
-        if (size != 1)
-            die(file, line, EXIT_FAILURE, "Only size 1 variable can be a condition");
+    void outputCompareInstruction(const std::string &file, int line, CompilationState &state,
+                                  cellReference isZero, cellReference notZero, cellReference condition, cellSize size) {
         Instruction i(file, line, InstructionName::COMPARE);
         i.compare.conditionAddress = condition;
+        i.compare.size = size;
         i.compare.isZero = isZero;
         i.compare.notZero = notZero;
         i.comment = "cond@" + to_string(i.compare.conditionAddress) + ", isZero@" + to_string(isZero) + ", notZero@" + to_string(notZero);
-        outputInstruction(i);
+        outputInstruction(state, i);
     }
 
-    void outputTestInstruction(const std::string &file, int line, const SymbolResolutionResult &condition, cellReference jumpRegister, label onTrue, label onFalse) {
+    void outputTestInstruction(const std::string &file, int line, CompilationState &state, const SymbolResolutionResult &condition, cellReference jumpRegister, label onTrue, label onFalse) {
         Instruction i(file, line, InstructionName::TEST, "truebr@" + to_string(onTrue) + ", " + "falsebr@" + to_string(onFalse) + ", jmpreg@" + to_string(jumpRegister));
         i.test.jumpRegister = jumpRegister;
         i.test.isTrue = jumpRegister + 1;
@@ -378,36 +903,610 @@ namespace {
         i.test.trueLabel = onTrue;
         i.test.falseLabel = onFalse;
 
-        if (condition.resolved->getSizeOnTheStack() != 1)
-            die(file, line, EXIT_FAILURE, "Condition not of size 1");
+        // u16 and u32 are true, if any of their cells is not zero
+        auto size = (int) condition.size();
+        if (!isNumber(state, asVariable(file, line, condition)->type))
+            die(file, line, EXIT_FAILURE, "Condition not a number");
 
-        if (condition.resolved->temp) {
-            outputCompareInstruction(file, line, i.test.isFalse, i.test.isTrue, (int) condition.dereference(file, line), 1);
+        if (condition.resolved->temp || condition.lastUse) {
+            outputCompareInstruction(file, line, state, i.test.isFalse, i.test.isTrue, (int) condition.dereference(file, line), size);
         } else {
             auto aux = jumpRegister + 3;
-            outputCopyInstruction(file, line, aux, static_cast<int>(condition.dereference(file, line)), i.test.isTrue);
-            outputCompareInstruction(file, line, i.test.isFalse, i.test.isTrue, aux, 1);
+            for (int c = 0; c < size; c++)
+                outputCopyInstruction(file, line, state, aux + c, static_cast<int>(condition.dereference(file, line)) + c, i.test.isTrue);
+            outputCompareInstruction(file, line, state, i.test.isFalse, i.test.isTrue, aux, size);
         }
-        outputInstruction(i);
+        outputInstruction(state, i);
     }
 
-    void outputJumpInstruction(const std::string &file, int line, cellValue offset, label address, std::string comment = "") {
+    void outputBranchInstruction(const std::string &file, int line, CompilationState &state, InstructionName instr,
+                                 const SymbolResolutionResult &condition) {
+        Instruction i(file, line, instr, "cond@" + to_string(condition.dereference(file, line)));
+        i.branch.condition = (int) condition.dereference(file, line);
+        outputInstruction(state, i);
+    }
+
+    void outputJumpInstruction(const std::string &file, int line, CompilationState &state,
+                               cellValue offset, label address, std::string comment = "") {
         Instruction i(file, line, InstructionName::JUMP, std::move(comment));
         i.jump.targetAddress = address;
-        outputStackInstruction(file, line, false, offset);
-        outputInstruction(i);
+        outputStackInstruction(file, line, state, false, offset);
+        outputInstruction(state, i);
     }
 
-    void outputLoadStringInstruction(const std::string &file, int line, const SymbolResolutionResult& dst, const std::string &str) {
+    // prints each character by adding the difference to the previous one to 'cell'
+    void outputPrintStringInstruction(const std::string &file, int line, CompilationState &state,
+                                      const SymbolResolutionResult &cell, const std::string &str, cellReference aux) {
+        char previous = 0;
+        for (size_t i = 0; i < str.size(); i++) {
+            Instruction instr(file, line, i == 0 ? InstructionName::ILOAD : InstructionName::IADD,
+                              result2str(file, line, cell) + " " + to_string(i == 0 ? (int) str[i] : str[i] - previous));
+            instr.constant.size = 1;
+            instr.constant.dst = static_cast<cellReference>(cell.dereference(file, line));
+            instr.constant.value = i == 0 ? str[i] : str[i] - previous;
+            instr.constant.aux = aux;
+            outputInstruction(state, instr);
+            outputIoInstruction(file, line, state, IOStatement::IOFunction::IOOUTPUT, cell);
+            previous = str[i];
+        }
+    }
+
+    void outputLoadStringInstruction(const std::string &file, int line, CompilationState &state,
+                                     const SymbolResolutionResult& dst, const std::string &str, cellReference aux) {
         auto adr = dst.dereference(file, line);
         for (int i = 0; i < str.size(); i++) {
             Instruction instr(file, line, InstructionName::ILOAD, result2str(file, line, dst) + "+" + to_string(i) + ", " + to_string((int)str[i]));
             instr.constant.size = 1;
             instr.constant.dst = static_cast<cellReference>(adr + i);
             instr.constant.value = str[i];
-            outputInstruction(instr);
+            instr.constant.aux = aux;
+            outputInstruction(state, instr);
         }
     }
+
+    // reads the element at the index in 'index' of 'array' into 'value', or writes 'value' into it. The index and the
+    // written value are cleared
+    void outputArrayInstruction(const std::string &file, int line, CompilationState &state,
+                                InstructionName instr, const SymbolResolutionResult &array,
+                                const SymbolResolutionResult &index, const SymbolResolutionResult &value) {
+        auto var = asVariable(file, line, array);
+        Instruction i(file, line, instr, dereference(file, line, array) + "[" + dereference(file, line, index) + "] "
+                                         + dereference(file, line, value));
+        i.array.array = (int) array.dereference(file, line);
+        i.array.index = (int) index.dereference(file, line);
+        i.array.value = (int) value.dereference(file, line);
+        i.array.size = (int) var->type->getSizeSumOfChildSymbols();
+        i.array.length = (int) array.size();
+        outputInstruction(state, i);
+    }
+
+    void outputArrayClearInstruction(const std::string &file, int line, CompilationState &state,
+                                     const VariableSymbol *var, cellReference address);
+
+    // clears the arrays among the members of 'type' at 'address'
+    void outputArrayClearInstruction(const std::string &file, int line, CompilationState &state,
+                                     const TypeSymbol *type, cellReference address) {
+        for (auto s : type->symbols)
+            if (auto member = dynamic_cast<const VariableSymbol*>(s))
+                outputArrayClearInstruction(file, line, state, member, address + (int) member->getAddressRelativeToParent());
+    }
+
+    // the walks to the elements of an array need zeros in the marker and carry cells, so they are cleared once the
+    // array is defined
+    void outputArrayClearInstruction(const std::string &file, int line, CompilationState &state,
+                                     const VariableSymbol *var, cellReference address) {
+        if (!var->isArray) {
+            outputArrayClearInstruction(file, line, state, var->type, address);
+            return;
+        }
+        auto size = (int) var->type->getSizeSumOfChildSymbols();
+        for (int k = 0; k <= var->length; k++) {
+            auto marker = address + k * (int) var->getElementStride();
+            for (int c = 0; c <= size; c++) {
+                Instruction i(file, line, InstructionName::ILOAD, var->name + "+" + to_string(marker + c - address) + " 0");
+                i.constant.dst = marker + c;
+                i.constant.size = 1;
+                i.constant.value = 0;
+                i.constant.aux = -1;
+                outputInstruction(state, i);
+            }
+            if (k < var->length)
+                outputArrayClearInstruction(file, line, state, var->type, address + (int) var->getElementAddress(k));
+        }
+    }
+
+    // forgets the results of compiling 'e', so that it can be compiled again at another place
+    void resetExpression(Expression *e) {
+        if (e == nullptr)
+            return;
+        e->out = SymbolResolutionResult(nullptr);
+        e->dst = SymbolResolutionResult(nullptr);
+        if (auto dot = dynamic_cast<DotExpression*>(e)) {
+            resetExpression(dot->lhs);
+            resetExpression(dot->rhs);
+        } else if (auto index = dynamic_cast<IndexExpression*>(e)) {
+            resetExpression(index->array);
+            resetExpression(index->index);
+        } else if (auto call = dynamic_cast<CallExpression*>(e)) {
+            call->argumentsToPush.clear();
+            call->returnValuesToPop.clear();
+            resetExpression(call->fun);
+            resetExpression(call->arguments);
+        } else if (auto binop = dynamic_cast<BinaryOperatorExpression*>(e)) {
+            resetExpression(binop->lhs);
+            resetExpression(binop->rhs);
+        } else if (auto tuple = dynamic_cast<TupleExpression*>(e)) {
+            for (auto t : tuple->tuple)
+                resetExpression(t);
+        }
+    }
+
+    // the variable, whose cells are referred to by a member or element access, or nullptr for computed values
+    IdentifierExpression *baseIdentifier(Expression *e) {
+        while (true) {
+            if (auto dot = dynamic_cast<DotExpression*>(e))
+                e = dot->lhs;
+            else if (auto index = dynamic_cast<IndexExpression*>(e))
+                e = index->array;
+            else
+                return dynamic_cast<IdentifierExpression*>(e);
+        }
+    }
+
+    // whether a variable called 'name' is read anywhere in 'e'
+    bool mentions(Expression *e, const std::string &name) {
+        if (auto id = dynamic_cast<IdentifierExpression*>(e))
+            return *id->identifier == name;
+        if (auto dot = dynamic_cast<DotExpression*>(e))
+            // the right side names a member
+            return mentions(dot->lhs, name);
+        if (auto index = dynamic_cast<IndexExpression*>(e))
+            return mentions(index->array, name) || mentions(index->index, name);
+        if (auto call = dynamic_cast<CallExpression*>(e))
+            return mentions(call->fun, name) || mentions(call->arguments, name);
+        if (auto binop = dynamic_cast<BinaryOperatorExpression*>(e))
+            return mentions(binop->lhs, name) || mentions(binop->rhs, name);
+        if (auto tuple = dynamic_cast<TupleExpression*>(e))
+            return std::any_of(tuple->tuple.begin(), tuple->tuple.end(), [&](Expression *t) { return mentions(t, name); });
+        return false;
+    }
+
+    // whether evaluating 'e' calls a function, which jumps through the dispatcher
+    bool hasCall(Expression *e) {
+        if (dynamic_cast<CallExpression*>(e))
+            return true;
+        if (auto dot = dynamic_cast<DotExpression*>(e))
+            return hasCall(dot->lhs);
+        if (auto index = dynamic_cast<IndexExpression*>(e))
+            return hasCall(index->array) || hasCall(index->index);
+        if (auto binop = dynamic_cast<BinaryOperatorExpression*>(e))
+            return hasCall(binop->lhs) || hasCall(binop->rhs);
+        if (auto tuple = dynamic_cast<TupleExpression*>(e))
+            return std::any_of(tuple->tuple.begin(), tuple->tuple.end(), hasCall);
+        return false;
+    }
+
+    // Marks the calls, after which the function ends. They are the last statement of the body, of the branches of
+    // a final if statement, or the value of such a statement, that is returned or assigned. Returns whether a call
+    // was marked.
+    bool markTailCalls(Statement *s) {
+        if (auto list = dynamic_cast<ListStatement*>(s)) {
+            // declarations and empty statements don't generate code
+            auto last = std::find_if(list->list->rbegin(), list->list->rend(), [](Statement *stmt) {
+                return typeid(*stmt) != typeid(Statement) && dynamic_cast<VariableStatement*>(stmt) == nullptr
+                       && dynamic_cast<TypeStatement*>(stmt) == nullptr && dynamic_cast<FunctionStatement*>(stmt) == nullptr;
+            });
+            if (last != list->list->rend())
+                return markTailCalls(*last);
+        } else if (auto ifstmt = dynamic_cast<IfStatement*>(s)) {
+            bool marked = markTailCalls(ifstmt->onTrue);
+            if (ifstmt->onFalse != nullptr)
+                marked = markTailCalls(ifstmt->onFalse) || marked;
+            return marked;
+        } else if (auto ret = dynamic_cast<ReturnStatement*>(s)) {
+            if (auto call = dynamic_cast<CallExpression*>(ret->expr))
+                return call->tailCall = true;
+        } else if (auto expr = dynamic_cast<ExpressionStatement*>(s)) {
+            auto assign = dynamic_cast<BinaryOperatorExpression*>(expr->expr);
+            if (auto call = dynamic_cast<CallExpression*>(expr->expr))
+                return call->tailCall = true;
+            else if (assign != nullptr && assign->op == BinaryOperatorExpression::OP_MOV)
+                if (auto call = dynamic_cast<CallExpression*>(assign->rhs))
+                    return call->tailCall = true;
+        }
+        return false;
+    }
+
+    // Finds the last read of each local variable in a function body, so that it can be moved instead of copied.
+    // Variables are told apart by their declaration, found with the same scoping rules as the symbol table.
+    class LastUseAnalysis {
+        typedef std::set<const VariableDefinition*> Live;
+
+        std::map<const IdentifierExpression*, const VariableDefinition*> declarations;
+        vector<std::map<string, const VariableDefinition*>> scopes;
+        // inline code may read any cell of the frame
+        bool hasInline = false;
+        // variables, that are assigned or read into, as a whole or a member or element of them
+        std::set<const VariableDefinition*> written;
+        // printing reads a variable without destroying it, even at its last use
+        std::set<const IdentifierExpression*> printed;
+        // whether the last reads are marked, otherwise only the read-only parameters are found
+        bool moves;
+
+        void declare(const VariableDefinition *def) {
+            scopes.back()[*def->name] = def;
+        }
+
+        void resolve(Expression *e) {
+            if (auto id = dynamic_cast<IdentifierExpression*>(e)) {
+                for (auto scope = scopes.rbegin(); scope != scopes.rend(); ++scope) {
+                    auto def = scope->find(*id->identifier);
+                    if (def != scope->end()) {
+                        declarations[id] = def->second;
+                        break;
+                    }
+                }
+            } else if (auto dot = dynamic_cast<DotExpression*>(e)) {
+                // the right side names a member
+                resolve(dot->lhs);
+            } else if (auto index = dynamic_cast<IndexExpression*>(e)) {
+                resolve(index->array);
+                resolve(index->index);
+            } else if (auto call = dynamic_cast<CallExpression*>(e)) {
+                resolve(call->fun);
+                if (call->arguments != nullptr)
+                    resolve(call->arguments);
+            } else if (auto binop = dynamic_cast<BinaryOperatorExpression*>(e)) {
+                resolve(binop->lhs);
+                resolve(binop->rhs);
+            } else if (auto tuple = dynamic_cast<TupleExpression*>(e)) {
+                for (auto t : tuple->tuple)
+                    resolve(t);
+            }
+        }
+
+        void resolve(Statement *s, bool newScope = true) {
+            if (s == nullptr)
+                return;
+            if (newScope)
+                scopes.emplace_back();
+            if (auto list = dynamic_cast<ListStatement*>(s)) {
+                for (auto stmt : *list->list)
+                    resolve(stmt, dynamic_cast<ListStatement*>(stmt) != nullptr);
+            } else if (auto var = dynamic_cast<VariableStatement*>(s)) {
+                for (auto def : *var->variables)
+                    declare(def);
+            } else if (auto ifstmt = dynamic_cast<IfStatement*>(s)) {
+                resolve(ifstmt->condition);
+                resolve(ifstmt->onTrue);
+                resolve(ifstmt->onFalse);
+            } else if (auto whilestmt = dynamic_cast<WhileStatement*>(s)) {
+                resolve(whilestmt->condition);
+                resolve(whilestmt->body);
+            } else if (auto ret = dynamic_cast<ReturnStatement*>(s)) {
+                if (ret->expr != nullptr)
+                    resolve(ret->expr);
+            } else if (auto io = dynamic_cast<IOStatement*>(s)) {
+                resolve(io->expr);
+                auto tuple = dynamic_cast<TupleExpression*>(io->expr);
+                for (auto e : tuple != nullptr ? tuple->tuple : vector<Expression*>{io->expr})
+                    if (!io->isInput() && dynamic_cast<IndexExpression*>(e) == nullptr && baseIdentifier(e) != nullptr)
+                        printed.insert(baseIdentifier(e));
+            } else if (auto expr = dynamic_cast<ExpressionStatement*>(s)) {
+                resolve(expr->expr);
+            } else if (dynamic_cast<InlineStatement*>(s) != nullptr) {
+                hasInline = true;
+            }
+            if (newScope)
+                scopes.pop_back();
+        }
+
+        const VariableDefinition *declaration(Expression *e) const {
+            auto id = dynamic_cast<IdentifierExpression*>(e);
+            auto def = id != nullptr ? declarations.find(id) : declarations.end();
+            return def != declarations.end() ? def->second : nullptr;
+        }
+
+        // the variable of 'e' is overwritten
+        void kill(Expression *e, Live &live) {
+            live.erase(declaration(e));
+            written.insert(declaration(baseIdentifier(e)));
+        }
+
+        // the value of 'e' is read; 'live' holds the variables read afterwards
+        void read(Expression *e, Live &live) {
+            if (auto id = dynamic_cast<IdentifierExpression*>(e)) {
+                auto def = declaration(id);
+                if (def != nullptr) {
+                    id->lastUse = moves && live.count(def) == 0;
+                    live.insert(def);
+                }
+            } else if (auto dot = dynamic_cast<DotExpression*>(e)) {
+                read(dot->lhs, live);
+            } else if (auto index = dynamic_cast<IndexExpression*>(e)) {
+                // the element is read after the index is evaluated
+                read(index->array, live);
+                read(index->index, live);
+            } else if (auto call = dynamic_cast<CallExpression*>(e)) {
+                // the arguments are evaluated after the 'this' object
+                if (call->arguments != nullptr)
+                    read(call->arguments, live);
+                if (dynamic_cast<DotExpression*>(call->fun) != nullptr)
+                    read(call->fun, live);
+            } else if (auto tuple = dynamic_cast<TupleExpression*>(e)) {
+                for (auto t = tuple->tuple.rbegin(); t != tuple->tuple.rend(); ++t)
+                    read(*t, live);
+            } else if (auto binop = dynamic_cast<BinaryOperatorExpression*>(e)) {
+                auto lhstuple = dynamic_cast<TupleExpression*>(binop->lhs);
+                auto rhstuple = dynamic_cast<TupleExpression*>(binop->rhs);
+                if (binop->op != BinaryOperatorExpression::OP_MOV) {
+                    read(binop->rhs, live);
+                    read(binop->lhs, live);
+                } else if (lhstuple && rhstuple) {
+                    // the pairs are assigned one after the other
+                    for (auto i = lhstuple->tuple.size(); i-- > 0 && i < rhstuple->tuple.size();) {
+                        kill(lhstuple->tuple[i], live);
+                        read(rhstuple->tuple[i], live);
+                    }
+                } else if (lhstuple) {
+                    for (auto t : lhstuple->tuple)
+                        kill(t, live);
+                    read(binop->rhs, live);
+                } else {
+                    kill(binop->lhs, live);
+                    // an element is written after the value and its index are evaluated, the array stays live
+                    if (auto index = dynamic_cast<IndexExpression*>(binop->lhs))
+                        read(index->index, live);
+                    read(binop->rhs, live);
+                }
+            }
+        }
+
+        // returns the variables live before 's', given the ones live after it
+        Live statement(Statement *s, Live live) {
+            if (auto list = dynamic_cast<ListStatement*>(s)) {
+                for (auto stmt = list->list->rbegin(); stmt != list->list->rend(); ++stmt)
+                    live = statement(*stmt, live);
+            } else if (auto var = dynamic_cast<VariableStatement*>(s)) {
+                for (auto def : *var->variables)
+                    live.erase(def);
+            } else if (auto ifstmt = dynamic_cast<IfStatement*>(s)) {
+                auto onTrue = statement(ifstmt->onTrue, live);
+                auto onFalse = ifstmt->onFalse != nullptr ? statement(ifstmt->onFalse, live) : live;
+                onTrue.insert(onFalse.begin(), onFalse.end());
+                live = onTrue;
+                read(ifstmt->condition, live);
+            } else if (auto whilestmt = dynamic_cast<WhileStatement*>(s)) {
+                // iterate until the variables live at the condition don't change anymore
+                Live head;
+                while (true) {
+                    auto next = statement(whilestmt->body, head);
+                    next.insert(live.begin(), live.end());
+                    read(whilestmt->condition, next);
+                    if (next == head)
+                        break;
+                    head = next;
+                }
+                live = head;
+            } else if (auto ret = dynamic_cast<ReturnStatement*>(s)) {
+                if (ret->expr != nullptr)
+                    read(ret->expr, live);
+            } else if (auto io = dynamic_cast<IOStatement*>(s)) {
+                if (io->isInput()) {
+                    auto tuple = dynamic_cast<TupleExpression*>(io->expr);
+                    for (auto e : tuple != nullptr ? tuple->tuple : vector<Expression*>{io->expr}) {
+                        kill(e, live);
+                        if (auto index = dynamic_cast<IndexExpression*>(e))
+                            read(index->index, live);
+                    }
+                } else {
+                    read(io->expr, live);
+                }
+            } else if (auto expr = dynamic_cast<ExpressionStatement*>(s)) {
+                read(expr->expr, live);
+            }
+            return live;
+        }
+
+    public:
+        explicit LastUseAnalysis(bool moves) : moves(moves) {}
+
+        // marks the last reads in the body of 'function'
+        void run(FunctionStatement &function) {
+            scopes.emplace_back();
+            Live exit;
+            if (function.returnVariables != nullptr) {
+                for (auto def : *function.returnVariables) {
+                    declare(def);
+                    // return values are read by the caller
+                    exit.insert(def);
+                }
+            }
+            if (function.parameterVariables != nullptr)
+                for (auto def : *function.parameterVariables)
+                    declare(def);
+            resolve(function.functionBody, false);
+            if (!hasInline)
+                statement(function.functionBody, exit);
+            scopes.pop_back();
+        }
+
+        // whether the body leaves the variable unchanged, its last read may move it away unless it is printed
+        bool isReadOnly(const VariableDefinition *def) const {
+            if (hasInline || written.count(def) > 0)
+                return false;
+            return std::none_of(declarations.begin(), declarations.end(), [&](const decltype(declarations)::value_type &d) {
+                return d.second == def && d.first->lastUse && printed.count(d.first) == 0;
+            });
+        }
+    };
+
+    // replaces the value of 'cell' with 1 if it is not zero and with 0 if it is, or the opposite if 'negate' is set
+    void outputBooleanInstruction(const std::string &file, int line, CompilationState &state,
+                                  const SymbolResolutionResult &cell, bool negate) {
+        state.symbolTable.push(*state.symbolTable.newTmpStackframe(line));
+        auto flags = state.symbolTable.newTmpVariable(line, state.cellType, 2, "__scratch");
+        auto isZero = (int) flags.dereference(file, line);
+        auto address = (int) cell.dereference(file, line);
+        // the other cells of a u16 or u32 are cleared
+        outputCompareInstruction(file, line, state, isZero, isZero + 1, address, (int) cell.size());
+        outputMoveInstruction(file, line, state, address, negate ? isZero : isZero + 1);
+        state.symbolTable.pop();
+    }
+
+    // evaluates expressions, that only consist of integer constants, at compile time, on numbers with 'range' values
+    bool evaluateConstant(const CompilationState &state, Expression *expression, cellValue &value, cellValue range) {
+        if (auto integer = dynamic_cast<IntExpression*>(expression)) {
+            value = integer->integer;
+            return true;
+        }
+        auto binop = dynamic_cast<BinaryOperatorExpression*>(expression);
+        cellValue lhs, rhs;
+        if (binop == nullptr || !evaluateConstant(state, binop->lhs, lhs, range) || !evaluateConstant(state, binop->rhs, rhs, range))
+            return false;
+        auto wrap = [range](cellValue v) { return ((v % range) + range) % range; };
+        switch (binop->op) {
+            case BinaryOperatorExpression::OP_ADD:
+                value = lhs + rhs; return true;
+            case BinaryOperatorExpression::OP_SUB:
+                value = lhs - rhs; return true;
+            case BinaryOperatorExpression::OP_MUL:
+                value = wrap(wrap(lhs) * wrap(rhs)); return true;
+            case BinaryOperatorExpression::OP_DIV:
+            case BinaryOperatorExpression::OP_MOD:
+                // the cells hold the operands modulo the cell size
+                if (wrap(rhs) == 0)
+                    die(state.currentFile, binop->line, EXIT_FAILURE, "Division by zero");
+                value = binop->op == BinaryOperatorExpression::OP_DIV ? wrap(lhs) / wrap(rhs) : wrap(lhs) % wrap(rhs);
+                return true;
+            case BinaryOperatorExpression::OP_EQ:
+                value = wrap(lhs) == wrap(rhs); return true;
+            case BinaryOperatorExpression::OP_NE:
+                value = wrap(lhs) != wrap(rhs); return true;
+            case BinaryOperatorExpression::OP_LT:
+                value = wrap(lhs) < wrap(rhs); return true;
+            case BinaryOperatorExpression::OP_LE:
+                value = wrap(lhs) <= wrap(rhs); return true;
+            case BinaryOperatorExpression::OP_GT:
+                value = wrap(lhs) > wrap(rhs); return true;
+            case BinaryOperatorExpression::OP_GE:
+                value = wrap(lhs) >= wrap(rhs); return true;
+            case BinaryOperatorExpression::OP_AND:
+                value = wrap(lhs) != 0 && wrap(rhs) != 0; return true;
+            case BinaryOperatorExpression::OP_OR:
+                value = wrap(lhs) != 0 || wrap(rhs) != 0; return true;
+            default:
+                return false;
+        }
+    }
+
+    // evaluates constant expressions on cells
+    bool evaluateConstant(const CompilationState &state, Expression *expression, cellValue &value) {
+        return evaluateConstant(state, expression, value, state.cellRange());
+    }
+
+    // resolves a variable, a member or a function without compiling the expression
+    SymbolResolutionResult resolve(CompilationState &state, Expression *e) {
+        if (auto id = dynamic_cast<IdentifierExpression*>(e))
+            return state.symbolTable.findGlobal(QualifiedName{*id->identifier});
+        if (auto index = dynamic_cast<IndexExpression*>(e)) {
+            // the element has the type of the array, its address is left out
+            auto result = resolve(state, index->array);
+            if (auto var = dynamic_cast<VariableSymbol*>(result.resolved))
+                result.elementSize = (int) var->type->getSizeSumOfChildSymbols();
+            return result;
+        }
+        auto dot = dynamic_cast<DotExpression*>(e);
+        auto member = dot != nullptr ? dynamic_cast<IdentifierExpression*>(dot->rhs) : nullptr;
+        if (member == nullptr)
+            return SymbolResolutionResult(nullptr);
+        auto result = resolve(state, dot->lhs);
+        if (result)
+            result.find(*member->identifier);
+        return result;
+    }
+
+    // type of the value of an expression, or nullptr for constants, that take the type of the other operand
+    TypeSymbol *expressionType(CompilationState &state, Expression *e) {
+        cellValue constant;
+        if (evaluateConstant(state, e, constant))
+            return nullptr;
+        if (auto binop = dynamic_cast<BinaryOperatorExpression*>(e)) {
+            switch (binop->op) {
+                case BinaryOperatorExpression::OP_MOV:
+                    return expressionType(state, binop->lhs);
+                case BinaryOperatorExpression::OP_ADD:
+                case BinaryOperatorExpression::OP_SUB:
+                case BinaryOperatorExpression::OP_MUL:
+                case BinaryOperatorExpression::OP_DIV:
+                case BinaryOperatorExpression::OP_MOD: {
+                    auto type = expressionType(state, binop->lhs);
+                    return type != nullptr ? type : expressionType(state, binop->rhs);
+                }
+                default:
+                    return state.cellType;
+            }
+        }
+        auto call = dynamic_cast<CallExpression*>(e);
+        auto result = resolve(state, call != nullptr ? call->fun : e);
+        if (auto fun = dynamic_cast<FunctionSymbol*>(result.resolved))
+            result = fun->returnValues.empty() ? SymbolResolutionResult(nullptr) : fun->returnValues.front();
+        auto var = dynamic_cast<VariableSymbol*>(result.resolved);
+        return var != nullptr ? var->type : state.cellType;
+    }
+
+    // constants are numbers of the type of their destination, or cells
+    TypeSymbol *constantType(CompilationState &state, const SymbolResolutionResult &dst) {
+        auto var = dst ? dynamic_cast<VariableSymbol*>(dst.resolved) : nullptr;
+        return var != nullptr && isNumber(state, var->type) ? var->type : state.cellType;
+    }
+
+    // the result of an expression of 'type' can be written into 'dst' instead of a temporary
+    bool writesCell(CompilationState &, const SymbolResolutionResult &dst, const TypeSymbol *type) {
+        auto var = dst ? dynamic_cast<VariableSymbol*>(dst.resolved) : nullptr;
+        return var != nullptr && var->type == type && dst.size() == type->getSizeSumOfChildSymbols();
+    }
+
+    // loads a constant directly into a parameter or return value of a number type, which has no destination to take
+    // its type from
+    bool loadConstant(CompilationState &state, Expression *e, const SymbolResolutionResult &dst) {
+        auto type = constantType(state, dst);
+        cellValue constant;
+        if (!writesCell(state, dst, type) || !evaluateConstant(state, e, constant, numberRange(state, type)))
+            return false;
+        auto aux = (int) state.symbolTable.currentScope()->getCurrentAddressOfFunctionStackframeEnd();
+        outputIntegerInstruction(state.currentFile, e->line, state, BinaryOperatorExpression::OP_MOV, dst, constant, aux);
+        return true;
+    }
+
+    void checkReturnsValue(const std::string &file, int line, Expression *expression) {
+        auto call = dynamic_cast<CallExpression*>(expression);
+        if (call && call->returnValuesToPop.size() == 0)
+            die(file, line, EXIT_FAILURE, "Function does not return a value");
+        if (call && call->returnValuesToPop.size() > 1)
+            errprintln(file + ":" + to_string(line), "Warning: Function returns more than one value. Using only the first return value.");
+    }
+
+    // creates a temporary of the type and length of a parameter or return value, that is never reused
+    SymbolResolutionResult newTmpLike(CompilationState &state, int line, const VariableSymbol *var, const char *prefix) {
+        auto result = state.symbolTable.newTmpVariable(line, var->type, var->isPointerType ? var->length : -1, prefix, false);
+        static_cast<VariableSymbol*>(result.resolved)->isArray = var->isArray;
+        return result;
+    }
+
+    // evaluates the index of an array access into a cell, that the walk to the element may clear
+    SymbolResolutionResult compileArrayIndex(CompilationState &state, IndexExpression *e) {
+        e->index->compile(state);
+        checkReturnsValue(state.currentFile, e->line, e->index);
+        auto index = e->index->out;
+        if (asVariable(state.currentFile, e->line, index)->type != state.cellType || index.size() != 1)
+            die(state.currentFile, e->line, EXIT_FAILURE, "Array index", dereference(state.currentFile, e->line, index), "is not a cell");
+        if (index.resolved->temp || index.lastUse)
+            return index;
+        auto copy = state.symbolTable.newTmpVariable(e->line, state.cellType);
+        outputAutoMoveInstruction(state.currentFile, e->line, state, BinaryOperatorExpression::OP_MOV, copy, index);
+        return copy;
+    }
 }
 
 ostream &operator<<(ostream &os, const Symbol &symbol) {
@@ -451,12 +1550,14 @@ ostream &operator<<(ostream &os, const SymbolTable &st) {
     return os << endl;
 }
 
-QualifiedName Symbol::getQualified() const {
-    QualifiedName qn;
-    if ((parent != nullptr) && parent->parent)
-        qn = parent->getQualified();
-    qn.push_back(name);
-    return qn;
+const QualifiedName &Symbol::getQualified() const {
+    if (!qualified) {
+        qualified.reset(new QualifiedName);
+        if ((parent != nullptr) && parent->parent)
+            *qualified = parent->getQualified();
+        qualified->push_back(name);
+    }
+    return *qualified;
 }
 
 void Symbol::setParent(Symbol *newParent) {
@@ -466,7 +1567,35 @@ void Symbol::setParent(Symbol *newParent) {
     if (parent != nullptr)
         die(file, line, EXIT_FAILURE, "Scope already set");
     parent = newParent;
+    qualified.reset();
     newParent->symbols.push_back(this);
+
+    // small scopes are scanned, larger ones get an index; names are unique in a scope, see SymbolTable::add
+    const size_t indexedSize = 16;
+    if (newParent->index) {
+        (*newParent->index)[name] = this;
+    } else if (newParent->symbols.size() >= indexedSize) {
+        newParent->index.reset(new ChildIndex);
+        for (auto s : newParent->symbols)
+            (*newParent->index)[s->name] = s;
+    }
+}
+
+Symbol *Symbol::findChild(const string &childName) const {
+    if (index) {
+        auto child = index->find(std::cref(childName));
+        return child != index->end() ? child->second : nullptr;
+    }
+    for (auto s : symbols)
+        if (s->name == childName)
+            return s;
+    return nullptr;
+}
+
+void Symbol::removeChild(vector<Symbol*>::iterator child) {
+    if (index)
+        index->erase((*child)->name);
+    symbols.erase(child);
 }
 
 vector<const Symbol *> Symbol::fullPath() const {
@@ -477,6 +1606,16 @@ vector<const Symbol *> Symbol::fullPath() const {
     return path;
 }
 
+size_t Symbol::getLiveSizeOfChildSymbols() const {
+    size_t size = 0, live = 0;
+    for (auto s : symbols) {
+        size += s->getSizeOnTheStack();
+        if (!s->released)
+            live = size;
+    }
+    return live;
+}
+
 const FunctionSymbol *Symbol::getParentFunctionStackframe() const {
     return dynamic_cast<const FunctionSymbol*>(this) != nullptr
            ? dynamic_cast<const FunctionSymbol*>(this)
@@ -485,7 +1624,7 @@ const FunctionSymbol *Symbol::getParentFunctionStackframe() const {
 
 SymbolTable::SymbolTable() {
     // initialize scope stack with the global scope
-    auto root = new StackframeSymbol(0, "<init>", "__root__");
+    auto root = create<StackframeSymbol>(0, "<init>", "__root__");
     push(*root);
 }
 
@@ -498,7 +1637,7 @@ void SymbolTable::push(Symbol &symbol) {
 }
 
 void SymbolTable::add(Symbol &symbol, bool temporary) {
-    auto result = findGlobal(symbol.getQualified());
+    auto result = findGlobal(QualifiedName{symbol.name});
     if (result && result.resolved->parent == currentScope())
         die(symbol.file, symbol.line, EXIT_FAILURE, "Redifinition of " + symbol2str(symbol) + ", defined as " + symbol2str(*result.resolved) + " in line " + to_string(result.resolved->line) + ",");
     symbol.setParent(currentScope());
@@ -506,17 +1645,44 @@ void SymbolTable::add(Symbol &symbol, bool temporary) {
 }
 
 void SymbolTable::pop() {
+    auto scope = scopeStack.back();
     scopeStack.pop_back();
     assert(scopeStack.back());
+    // temporary stackframes without symbols are not needed
+    if (scope->temp && scope->symbols.empty() && dynamic_cast<StackframeSymbol*>(scope) != nullptr) {
+        auto &siblings = scope->parent->symbols;
+        scope->parent->removeChild(std::find(siblings.begin(), siblings.end(), scope));
+    }
+    // temporaries released while the stackframe was alive can be removed now
+    trim(currentScope());
+}
+
+void SymbolTable::release(const SymbolResolutionResult &result) {
+    auto var = dynamic_cast<VariableSymbol*>(result.resolved);
+    if (var == nullptr || !var->temp || var->released)
+        return;
+    var->released = true;
+    // Temporaries of outer scopes stay in place until their stackframe is on top of the stack again
+    trim(currentScope());
 }
 
-SymbolResolutionResult SymbolTable::findGlobal(QualifiedName qualified) {
+void SymbolTable::trim(Symbol *scope) {
+    while (reuseTemporaries) {
+        auto last = std::find_if(scope->symbols.rbegin(), scope->symbols.rend(),
+                                 [](Symbol *s) { return dynamic_cast<VariableSymbol*>(s) != nullptr; });
+        if (last == scope->symbols.rend() || !(*last)->released)
+            break;
+        scope->removeChild(std::next(last).base());
+    }
+}
+
+SymbolResolutionResult SymbolTable::findGlobal(const QualifiedName &qualified) {
     Symbol *scope = currentScope();
     // begin search in current scope, and reduce scope by one, each time
     // the desired qualified qualifiedName is not found
     while (scope) {
         SymbolResolutionResult resolution(scope);
-        for (auto name : qualified) {
+        for (auto &name : qualified) {
             resolution.find(name);
             if (!resolution)
                 break;
@@ -531,35 +1697,45 @@ SymbolResolutionResult SymbolTable::findGlobal(QualifiedName qualified) {
     return SymbolResolutionResult(nullptr);
 }
 
-SymbolResolutionResult SymbolTable::newTmpVariable(int line, TypeSymbol *type, int length, const char *debug_prefix) {
-    static int tmpcount = 0;
-    auto newvar = new VariableSymbol(line, currentFile, debug_prefix + to_string(tmpcount++), type);
+SymbolResolutionResult SymbolTable::newTmpVariable(int line, TypeSymbol *type, int length, const char *debug_prefix, bool reuse) {
+    // reuse the cells of a dead temporary of the same type
+    for (auto s : reuse && reuseTemporaries ? currentScope()->symbols : vector<Symbol*>()) {
+        auto var = dynamic_cast<VariableSymbol*>(s);
+        if (var != nullptr && var->released && var->type == type && !var->isArray
+            && var->isPointerType == (length > 0) && var->length == (length > 0 ? length : 1)) {
+            var->released = false;
+            return findGlobal(QualifiedName{var->name});
+        }
+    }
+    // temporaries belong to the file of the function, that they are created in
+    auto newvar = create<VariableSymbol>(line, currentScope()->file, debug_prefix + to_string(tmpCount++), type);
     if (length > 0) {
         newvar->length = length;
         newvar->isPointerType = true;
     }
     add(*newvar, true);
-    // todo: delete tmp variables on leaving scope
-    // todo: don't bother with allocating memory, if I can just always use the end of the stack
     return findGlobal(QualifiedName{newvar->name});
 }
 
 StackframeSymbol *SymbolTable::newTmpStackframe(int line) {
-    static int tmpcount = 0;
-    auto frame = new StackframeSymbol(line, currentFile, "__frame" + to_string(tmpcount++));
+    auto frame = create<StackframeSymbol>(line, currentScope()->file, "__frame" + to_string(frameCount++));
+    // the frame starts right after the last live cell, dead temporaries before it are overwritten
+    frame->offset = reuseTemporaries ? currentScope()->getLiveSizeOfChildSymbols() : currentScope()->getSizeSumOfChildSymbols();
     add(*frame, true);
-    // todo: delete temporary stackframes on pop
-    // todo: if no need for tmp variables -> don't make tmp stackframes
     return frame;
 }
 
 void SymbolTable::initFunctionStackframe(const std::string &file, int line, bool temporary) {
-    add(*new VariableSymbol(line, file, "__ret", dynamic_cast<TypeSymbol *>(scopeStack[0]->symbols[0])), temporary);
+    add(*create<VariableSymbol>(line, file, "__ret", dynamic_cast<TypeSymbol *>(scopeStack[0]->symbols[0])), temporary);
 }
 
 void IntExpression::compile(CompilationState &state) {
-    out = state.symbolTable.newTmpVariable(line, state.cellType);
-    outputIntegerInstruction(file, line, BinaryOperatorExpression::OP_MOV, out, integer);
+    // load the constant directly into the destination, if there is one
+    auto type = constantType(state, dst);
+    out = writesCell(state, dst, type) ? dst : state.symbolTable.newTmpVariable(line, type);
+    // cells after the end of the current frame are free
+    auto aux = (int) state.symbolTable.currentScope()->getCurrentAddressOfFunctionStackframeEnd();
+    outputIntegerInstruction(state.currentFile, line, state, BinaryOperatorExpression::OP_MOV, out, integer, aux);
 }
 
 void IdentifierExpression::compile(CompilationState &state) {
@@ -568,7 +1744,8 @@ void IdentifierExpression::compile(CompilationState &state) {
     else
         out = state.symbolTable.findGlobal(QualifiedName{*identifier});
     if (!out)
-        die(file, line, EXIT_FAILURE, "Unresolved identifier", "'" + *identifier + "'");
+        die(state.currentFile, line, EXIT_FAILURE, "Unresolved identifier", "'" + *identifier + "'");
+    out.lastUse = lastUse;
 }
 
 IdentifierExpression::~IdentifierExpression() {
@@ -584,57 +1761,319 @@ void BinaryOperatorExpression::compile(CompilationState &state) {
     auto rhscall = dynamic_cast<CallExpression*>(rhs);
     auto lhstuple = dynamic_cast<TupleExpression*>(lhs);
     auto rhstuple = dynamic_cast<TupleExpression*>(rhs);
+    auto lhsindex = dynamic_cast<IndexExpression*>(lhs);
     if (op == OP_ADD || op == OP_SUB) {
         if (rhstuple || lhstuple)
-            die(file, line, EXIT_FAILURE, "Operator", binop2str(op),"not allowed on tuple expression");
-
-        out = state.symbolTable.newTmpVariable(line, state.cellType);
-        state.symbolTable.push(*state.symbolTable.newTmpStackframe(line));
-        // todo: use lookahead for direct compilation
-        // todo: lhs int expression can be statically compiled with operator ADD
+            die(state.currentFile, line, EXIT_FAILURE, "Operator", binop2str(op),"not allowed on tuple expression");
 
         /*
-         *  y = 1 - y; -> ILOAD aux 1;
-         *                SUB aux y;
-         *                MOV y aux;
-         *  y = 1 - x; -> ILOAD y 1;
-         *                SUB y x aux;
+         *  y = 1 + 2; -> ILOAD y 3;
          *  x = x - 1; -> ISUB x 1;
          *  y = x - 1; -> CPY y x aux;
          *                ISUB y 1;
+         *  y = 1 - x; -> ILOAD y 1;
+         *                SUB y x aux;
+         *  y = 1 - y; -> ILOAD aux 1;
+         *                SUB aux y;
+         *                MOV y aux;
          */
+        // constants take the type of the destination
+        auto type = expressionType(state, this);
+        if (type == nullptr)
+            type = constantType(state, dst);
+        cellValue constant;
+        if (evaluateConstant(state, this, constant, numberRange(state, type))) {
+            out = writesCell(state, dst, type) ? dst : state.symbolTable.newTmpVariable(line, type);
+            auto aux = (int) state.symbolTable.currentScope()->getCurrentAddressOfFunctionStackframeEnd();
+            outputIntegerInstruction(state.currentFile, line, state, OP_MOV, out, constant, aux);
+            return;
+        }
+
+        // x + c, c + x and x - c compile x and add the constant to it, (x + 1) + 2 adds 3 at once
+        Expression *base = nullptr;
+        cellValue offset = 0;
+        if (evaluateConstant(state, rhs, constant)) {
+            base = lhs;
+            offset = op == OP_ADD ? constant : -constant;
+        } else if (op == OP_ADD && evaluateConstant(state, lhs, constant)) {
+            base = rhs;
+            offset = constant;
+        }
+        while (auto inner = state.foldConstants ? dynamic_cast<BinaryOperatorExpression*>(base) : nullptr) {
+            if ((inner->op == OP_ADD || inner->op == OP_SUB) && evaluateConstant(state, inner->rhs, constant)) {
+                base = inner->lhs;
+                offset += inner->op == OP_ADD ? constant : -constant;
+            } else if (inner->op == OP_ADD && evaluateConstant(state, inner->lhs, constant)) {
+                base = inner->rhs;
+                offset += constant;
+            } else break;
+        }
+        if (base != nullptr) {
+            if (dynamic_cast<TupleExpression*>(base))
+                die(state.currentFile, line, EXIT_FAILURE, "Operator", binop2str(op),"not allowed on tuple expression");
+            bool intoDst = state.foldConstants && writesCell(state, dst, type);
+            out = intoDst ? dst : state.symbolTable.newTmpVariable(line, type);
+            // out is not alive before base is moved into it, so a call can place its frame on top of it
+            out.resolved->released = !intoDst && dynamic_cast<CallExpression*>(base) != nullptr;
+            state.symbolTable.push(*state.symbolTable.newTmpStackframe(line));
+            base->dst = out;
+            base->compile(state);
+            out.resolved->released = false;
+            checkType(state.currentFile, line, out, base->out);
+            checkReturnsValue(state.currentFile, line, base);
+            outputAutoMoveInstruction(state.currentFile, line, state, OP_MOV, out, base->out);
+            state.symbolTable.pop();
+            // x + 0 and x - 0 only move x
+            if (offset != 0) {
+                auto aux = (int) state.symbolTable.currentScope()->getCurrentAddressOfFunctionStackframeEnd();
+                outputIntegerInstruction(state.currentFile, line, state, OP_ADD, out, offset, aux);
+            }
+            return;
+        }
+
+        // c - x: load the constant into the destination and subtract x from it
+        if (evaluateConstant(state, lhs, constant)) {
+            out = state.foldConstants && writesCell(state, dst, type) ? dst : state.symbolTable.newTmpVariable(line, type);
+            state.symbolTable.push(*state.symbolTable.newTmpStackframe(line));
+            rhs->compile(state);
+            checkType(state.currentFile, line, out, rhs->out);
+            checkReturnsValue(state.currentFile, line, rhs);
+            // x is the destination itself, so the result is computed in a temporary
+            auto target = rhs->out.dereference(state.currentFile, line) == out.dereference(state.currentFile, line)
+                          ? state.symbolTable.newTmpVariable(line, type) : out;
+            auto aux = (int) state.symbolTable.currentScope()->getCurrentAddressOfFunctionStackframeEnd();
+            outputIntegerInstruction(state.currentFile, line, state, OP_MOV, target, constant, aux);
+            outputAutoMoveInstruction(state.currentFile, line, state, op, target, rhs->out);
+            outputAutoMoveInstruction(state.currentFile, line, state, OP_MOV, out, target);
+            state.symbolTable.pop();
+            return;
+        }
 
+        out = state.symbolTable.newTmpVariable(line, type);
+
+        // out is not alive before the lhs is moved into it, so a call on the lhs can place its frame on top of it
+        out.resolved->released = lhscall != nullptr;
         state.symbolTable.push(*state.symbolTable.newTmpStackframe(line));
         lhs->compile(state);
-        checkType(file, line, out, lhs->out);
+        out.resolved->released = false;
+        checkType(state.currentFile, line, out, lhs->out);
+        checkReturnsValue(state.currentFile, line, lhs);
+        outputAutoMoveInstruction(state.currentFile, line, state, BinaryOperatorExpression::OP_MOV, out, lhs->out);
+        state.symbolTable.pop();
 
-        if (lhscall && lhscall->returnValuesToPop.size() == 0)
-            die(file, line, EXIT_FAILURE, "Function does not return a value");
-        if (lhscall && lhscall->returnValuesToPop.size() > 1)
-            errprintln(file + ":" + to_string(line), "Warning: Function returns more than one value. Using only the first return value.");
+        state.symbolTable.push(*state.symbolTable.newTmpStackframe(line));
+        rhs->compile(state);
+        checkType(state.currentFile, line, out, rhs->out);
+        checkReturnsValue(state.currentFile, line, rhs);
+        outputAutoMoveInstruction(state.currentFile, line, state, op, out, rhs->out);
+        state.symbolTable.pop();
+    } else if (op == OP_MUL || op == OP_DIV || op == OP_MOD) {
+        if (rhstuple || lhstuple)
+            die(state.currentFile, line, EXIT_FAILURE, "Operator", binop2str(op),"not allowed on tuple expression");
+
+        auto type = expressionType(state, this);
+        if (type == nullptr)
+            type = constantType(state, dst);
+        cellValue constant;
+        if (evaluateConstant(state, this, constant, numberRange(state, type))) {
+            out = writesCell(state, dst, type) ? dst : state.symbolTable.newTmpVariable(line, type);
+            auto aux = (int) state.symbolTable.currentScope()->getCurrentAddressOfFunctionStackframeEnd();
+            outputIntegerInstruction(state.currentFile, line, state, OP_MOV, out, constant, aux);
+            return;
+        }
+        if (type->getSizeSumOfChildSymbols() > 1)
+            die(state.currentFile, line, EXIT_FAILURE, "Operator", binop2str(op), "is not implemented for", type->name);
+
+        // c * x is compiled as x * c
+        auto value = lhs, factor = rhs;
+        if (op == OP_MUL && evaluateConstant(state, lhs, constant))
+            std::swap(value, factor);
+        bool isConstant = evaluateConstant(state, factor, constant);
+        if (isConstant && op != OP_MUL && state.wrap(constant) == 0)
+            die(state.currentFile, line, EXIT_FAILURE, "Division by zero");
+
+        // the factor may read the destination, so only a constant allows computing the result in it
+        bool intoDst = isConstant && writesCell(state, dst, type);
+        out = intoDst ? dst : state.symbolTable.newTmpVariable(line, type);
+        out.resolved->released = !intoDst && dynamic_cast<CallExpression*>(value) != nullptr;
+        state.symbolTable.push(*state.symbolTable.newTmpStackframe(line));
+        value->dst = out;
+        value->compile(state);
+        out.resolved->released = false;
+        checkType(state.currentFile, line, out, value->out);
+        checkReturnsValue(state.currentFile, line, value);
+        outputAutoMoveInstruction(state.currentFile, line, state, OP_MOV, out, value->out);
+        state.symbolTable.pop();
 
-        outputAutoMoveInstruction(file, line, state.symbolTable, BinaryOperatorExpression::OP_MOV, out, lhs->out);
+        state.symbolTable.push(*state.symbolTable.newTmpStackframe(line));
+        if (isConstant) {
+            constant = state.wrap(constant);
+            auto aux = (int) state.symbolTable.currentScope()->getCurrentAddressOfFunctionStackframeEnd();
+            if ((op == OP_MUL && constant == 0) || (op == OP_MOD && constant == 1)) {
+                outputIntegerInstruction(state.currentFile, line, state, OP_MOV, out, 0, aux);
+            } else if (constant != 1) {
+                // multiplying only needs to move the value once, dividing needs the cells of the division loop
+                auto scratch = state.symbolTable.newTmpVariable(line, state.cellType, op == OP_MUL ? 1 : 6, "__scratch");
+                outputArithmeticInstruction(state.currentFile, line, state, op, out, constant, scratch);
+            }
+        } else {
+            factor->compile(state);
+            checkType(state.currentFile, line, out, factor->out);
+            checkReturnsValue(state.currentFile, line, factor);
+            auto scratch = state.symbolTable.newTmpVariable(line, state.cellType, op == OP_MUL ? 2 : 6, "__scratch");
+            outputArithmeticInstruction(state.currentFile, line, state, op, out, factor->out, scratch);
+        }
         state.symbolTable.pop();
+    } else if (op == OP_AND || op == OP_OR) {
+        if (rhstuple || lhstuple)
+            die(state.currentFile, line, EXIT_FAILURE, "Operator", binop2str(op),"not allowed on tuple expression");
+
+        cellValue constant;
+        if (evaluateConstant(state, this, constant)) {
+            out = writesCell(state, dst, state.cellType) ? dst : state.symbolTable.newTmpVariable(line, state.cellType);
+            auto aux = (int) state.symbolTable.currentScope()->getCurrentAddressOfFunctionStackframeEnd();
+            outputIntegerInstruction(state.currentFile, line, state, OP_MOV, out, constant, aux);
+            return;
+        }
 
+        // the rhs may read the destination, so the result is computed in a temporary
+        out = state.symbolTable.newTmpVariable(line, state.cellType);
+        out.resolved->released = lhscall != nullptr;
         state.symbolTable.push(*state.symbolTable.newTmpStackframe(line));
-        // statically compiles int expressions
-        rhs->compile(state);
-        checkType(file, line, out, rhs->out);
-        if (rhscall && rhscall->returnValuesToPop.size() == 0)
-            die(file, line, EXIT_FAILURE, "Function does not return a value");
-        if (rhscall && rhscall->returnValuesToPop.size() > 1)
-            errprintln(file + ":" + to_string(line),
-                       "Warning: Function returns more than one value. Using only the first return value.");
-        outputAutoMoveInstruction(file, line, state.symbolTable, op, out, rhs->out);
+        lhs->dst = out;
+        lhs->compile(state);
+        out.resolved->released = false;
+        checkType(state.currentFile, line, out, lhs->out);
+        checkReturnsValue(state.currentFile, line, lhs);
+        outputAutoMoveInstruction(state.currentFile, line, state, OP_MOV, out, lhs->out);
         state.symbolTable.pop();
 
+        // the rhs is only evaluated if the lhs doesn't decide the result, it leaves 0 or 1 in out
+        auto compileRhs = [&] {
+            state.symbolTable.push(*state.symbolTable.newTmpStackframe(line));
+            rhs->dst = out;
+            rhs->compile(state);
+            checkType(state.currentFile, line, out, rhs->out);
+            checkReturnsValue(state.currentFile, line, rhs);
+            outputAutoMoveInstruction(state.currentFile, line, state, OP_MOV, out, rhs->out);
+            outputBooleanInstruction(state.currentFile, line, state, out, false);
+            state.symbolTable.pop();
+        };
+
+        if (!hasCall(rhs)) {
+            // a flag, that is set if the rhs is needed, guards it with a loop, that runs at most once
+            auto flag = state.symbolTable.newTmpVariable(line, state.cellType);
+            outputBooleanInstruction(state.currentFile, line, state, out, op == OP_OR);
+            outputMoveInstruction(state.currentFile, line, state, (int) flag.dereference(state.currentFile, line), (int) out.dereference(state.currentFile, line));
+            // a true lhs decides '||'
+            if (op == OP_OR)
+                outputIntegerInstruction(state.currentFile, line, state, OP_MOV, out, 1);
+            outputBranchInstruction(state.currentFile, line, state, InstructionName::BEGIN_IF, flag);
+            compileRhs();
+            outputBranchInstruction(state.currentFile, line, state, InstructionName::END_IF, flag);
+            state.symbolTable.release(flag);
+            return;
+        }
+
+        // a call returns through the dispatcher, so the rhs is a block of its own, that is jumped to
+        auto rhsLabel = state.newJumpAddress();
+        auto trueLabel = op == OP_OR ? state.newJumpAddress() : -1;
+        auto endLabel = state.newJumpAddress();
+        auto jumpRegister = (int) state.symbolTable.currentScope()->getCurrentAddressOfFunctionStackframeEnd();
+        // the test clears out, which is the result of '&&' if the lhs is false
+        if (op == OP_AND)
+            outputTestInstruction(state.currentFile, line, state, out, jumpRegister, rhsLabel, endLabel);
+        else
+            outputTestInstruction(state.currentFile, line, state, out, jumpRegister, trueLabel, rhsLabel);
+        if (op == OP_OR) {
+            outputLabelInstruction(state.currentFile, line, state, jumpRegister, trueLabel, "OR_TRUE");
+            outputIntegerInstruction(state.currentFile, line, state, OP_MOV, out, 1);
+            outputJumpInstruction(state.currentFile, line, state, jumpRegister, endLabel, "OR_END");
+        }
+        outputLabelInstruction(state.currentFile, line, state, jumpRegister, rhsLabel, op == OP_AND ? "AND_RHS" : "OR_RHS");
+        compileRhs();
+        outputJumpInstruction(state.currentFile, line, state, jumpRegister, endLabel, op == OP_AND ? "AND_END" : "OR_END");
+        outputLabelInstruction(state.currentFile, line, state, jumpRegister, endLabel, op == OP_AND ? "AND_END" : "OR_END");
+    } else if (op == OP_EQ || op == OP_NE || op == OP_LT || op == OP_LE || op == OP_GT || op == OP_GE) {
+        if (rhstuple || lhstuple)
+            die(state.currentFile, line, EXIT_FAILURE, "Operator", binop2str(op),"not allowed on tuple expression");
+
+        // comparisons take numbers of any type
+        auto type = expressionType(state, lhs);
+        if (type == nullptr)
+            type = expressionType(state, rhs);
+        if (type == nullptr)
+            type = state.cellType;
+
+        cellValue constant;
+        if (evaluateConstant(state, this, constant, numberRange(state, type))) {
+            out = writesCell(state, dst, state.cellType) ? dst : state.symbolTable.newTmpVariable(line, state.cellType);
+            auto aux = (int) state.symbolTable.currentScope()->getCurrentAddressOfFunctionStackframeEnd();
+            outputIntegerInstruction(state.currentFile, line, state, OP_MOV, out, constant, aux);
+            return;
+        }
+
+        // the result replaces the lhs
+        bool isConstant = evaluateConstant(state, rhs, constant, numberRange(state, type));
+        bool intoDst = isConstant && writesCell(state, dst, state.cellType);
+        out = intoDst ? dst : state.symbolTable.newTmpVariable(line, state.cellType);
+        // u16 and u32 are compared in a temporary, that leaves the result in its first cell
+        auto operand = type != state.cellType ? state.symbolTable.newTmpVariable(line, type) : out;
+        operand.resolved->released = operand != dst && lhscall != nullptr;
+        state.symbolTable.push(*state.symbolTable.newTmpStackframe(line));
+        lhs->dst = operand;
+        lhs->compile(state);
+        operand.resolved->released = false;
+        checkType(state.currentFile, line, operand, lhs->out);
+        checkReturnsValue(state.currentFile, line, lhs);
+        outputAutoMoveInstruction(state.currentFile, line, state, OP_MOV, operand, lhs->out);
         state.symbolTable.pop();
+
+        state.symbolTable.push(*state.symbolTable.newTmpStackframe(line));
+        if ((op == OP_EQ || op == OP_NE) && type == state.cellType) {
+            // the difference is zero, if both sides are equal
+            auto aux = (int) state.symbolTable.currentScope()->getCurrentAddressOfFunctionStackframeEnd();
+            if (isConstant) {
+                if (state.wrap(constant) != 0)
+                    outputIntegerInstruction(state.currentFile, line, state, OP_ADD, out, -state.wrap(constant), aux);
+            } else {
+                rhs->compile(state);
+                checkType(state.currentFile, line, out, rhs->out);
+                checkReturnsValue(state.currentFile, line, rhs);
+                outputAutoMoveInstruction(state.currentFile, line, state, OP_SUB, out, rhs->out);
+            }
+            outputBooleanInstruction(state.currentFile, line, state, out, op == OP_EQ);
+        } else {
+            // the other operators consume a copy of the rhs
+            SymbolResolutionResult value(nullptr);
+            if (isConstant) {
+                value = state.symbolTable.newTmpVariable(line, type);
+                auto aux = (int) state.symbolTable.currentScope()->getCurrentAddressOfFunctionStackframeEnd();
+                outputIntegerInstruction(state.currentFile, line, state, OP_MOV, value, constant, aux);
+            } else {
+                rhs->compile(state);
+                checkType(state.currentFile, line, operand, rhs->out);
+                checkReturnsValue(state.currentFile, line, rhs);
+                value = rhs->out;
+                if (!value.resolved->temp && !value.lastUse) {
+                    value = state.symbolTable.newTmpVariable(line, type);
+                    outputAutoMoveInstruction(state.currentFile, line, state, OP_MOV, value, rhs->out);
+                }
+            }
+            auto scratch = state.symbolTable.newTmpVariable(line, state.cellType, operand.size() > 1 ? 5 : 4, "__scratch");
+            outputRelationInstruction(state.currentFile, line, state, op, operand, value, scratch);
+        }
+        state.symbolTable.pop();
+        if (operand != out) {
+            outputMoveInstruction(state.currentFile, line, state, (int) out.dereference(state.currentFile, line), (int) operand.dereference(state.currentFile, line));
+            state.symbolTable.release(operand);
+        }
     } else if (op == OP_MOV) {
         // todo: optimize expressions, that override itself by preventing uneccesary copies of references to temporary variables
         if (lhstuple && rhstuple) {
             // move values from one tuple to another
             if (lhstuple->tuple.size() != rhstuple->tuple.size()) {
-                die(file, line, EXIT_FAILURE,
+                die(state.currentFile, line, EXIT_FAILURE,
                     "Can't evaluate unsimilar tuples (length " + to_string(lhstuple->tuple.size()) + " vs. " +
                     to_string(rhstuple->tuple.size()) + ")");
             }
@@ -642,12 +2081,12 @@ void BinaryOperatorExpression::compile(CompilationState &state) {
                 auto lhs = lhstuple->tuple[i];
                 lhs->compile(state);
                 if (lhs->out.resolved->temp)
-                    die(file, line, EXIT_FAILURE, "Can't assign to temporary", dereference(file, line, lhs->out));
+                    die(state.currentFile, line, EXIT_FAILURE, "Can't assign to temporary", dereference(state.currentFile, line, lhs->out));
                 auto rhs = rhstuple->tuple[i];
                 rhs->dst = lhs->out;
                 state.symbolTable.push(*state.symbolTable.newTmpStackframe(line));
                 rhs->compile(state);
-                outputAutoMoveInstruction(file, line, state.symbolTable, op, lhs->out, rhs->out);
+                outputAutoMoveInstruction(state.currentFile, line, state, op, lhs->out, rhs->out);
                 state.symbolTable.pop();
             }
         } else if (lhstuple && rhscall) {
@@ -655,7 +2094,7 @@ void BinaryOperatorExpression::compile(CompilationState &state) {
 
             // move return values of method call into tuple
             if (lhstuple->tuple.size() != rhscall->returnValuesToPop.size()) {
-                die(file, line, EXIT_FAILURE,
+                die(state.currentFile, line, EXIT_FAILURE,
                     "Can't return values (" + to_string(lhstuple->tuple.size()),
                     "destinations vs.", rhscall->returnValuesToPop.size(), "values to return)");
             }
@@ -665,26 +2104,41 @@ void BinaryOperatorExpression::compile(CompilationState &state) {
                 auto lhs = lhstuple->tuple[i];
                 lhs->compile(state);
                 if (lhs->out.resolved->temp)
-                     die(file, line, EXIT_FAILURE, "Can't assign to temporary", dereference(file, line, lhs->out));
+                     die(state.currentFile, line, EXIT_FAILURE, "Can't assign to temporary", dereference(state.currentFile, line, lhs->out));
                 if (!rhs->out.resolved->temp)
-                    die(file, line, EXIT_FAILURE, "Returned reference?", dereference(file, line, rhs->out));
+                    die(state.currentFile, line, EXIT_FAILURE, "Returned reference?", dereference(state.currentFile, line, rhs->out));
                 auto rhs = rhscall->returnValuesToPop[i];
-                outputMoveInstruction(file, line, op, lhs->out, rhs);
+                outputMoveInstruction(state.currentFile, line, state, op, lhs->out, rhs);
+                state.symbolTable.release(rhs);
             }
         } else if (lhscall) {
-            die(file, line, EXIT_FAILURE, "Can't assign to function call");
+            die(state.currentFile, line, EXIT_FAILURE, "Can't assign to function call");
+        } else if (lhsindex && !lhsindex->isConstant(state)) {
+            // the value is carried to the element by the walk on the array, so it is computed in a temporary
+            auto value = state.symbolTable.newTmpVariable(line, expressionType(state, lhs));
+            value.resolved->released = rhscall != nullptr;
+            state.symbolTable.push(*state.symbolTable.newTmpStackframe(line));
+            rhs->dst = value;
+            rhs->compile(state);
+            value.resolved->released = false;
+            checkType(state.currentFile, line, value, rhs->out);
+            checkReturnsValue(state.currentFile, line, rhs);
+            outputAutoMoveInstruction(state.currentFile, line, state, op, value, rhs->out);
+            state.symbolTable.pop();
+            lhsindex->compileStore(state, value);
+            state.symbolTable.release(value);
         } else {
             lhs->compile(state);
             out = lhs->out;
-            if (asVariable(file, line, lhs->out)->temp)
-                die(file, line, EXIT_FAILURE, "Can't assign to temporary", dereference(file, line, lhs->out));
+            if (asVariable(state.currentFile, line, lhs->out)->temp)
+                die(state.currentFile, line, EXIT_FAILURE, "Can't assign to temporary", dereference(state.currentFile, line, lhs->out));
             rhs->dst = out;
             rhs->compile(state);
             if (rhscall && rhscall->returnValuesToPop.size() == 0)
-                die(file, line, EXIT_FAILURE, "Function does not return a value");
-            outputAutoMoveInstruction(file, line, state.symbolTable, op, out, rhs->out);
+                die(state.currentFile, line, EXIT_FAILURE, "Function does not return a value");
+            outputAutoMoveInstruction(state.currentFile, line, state, op, out, rhs->out);
         }
-    } else die(file, line, EXIT_FAILURE, "Unimplemented operator", binop2str(op));
+    } else die(state.currentFile, line, EXIT_FAILURE, "Unimplemented operator", binop2str(op));
 }
 
 BinaryOperatorExpression::~BinaryOperatorExpression() {
@@ -716,23 +2170,149 @@ DotExpression::~DotExpression() {
 DotExpression::DotExpression(Expression *lhs, Expression *rhs)
         : lhs(lhs), rhs(rhs), arg(nullptr) {}
 
+bool IndexExpression::isConstant(const CompilationState &state) const {
+    cellValue constant;
+    return evaluateConstant(state, index, constant);
+}
+
+void IndexExpression::compile(CompilationState &state) {
+    array->compile(state);
+    auto var = asArray(state.currentFile, line, array->out);
+    auto type = var->type;
+
+    // constant indices give the address of the element, which is used like a variable
+    cellValue constant;
+    if (evaluateConstant(state, index, constant)) {
+        if (constant < 0 || constant >= var->length)
+            die(state.currentFile, line, EXIT_FAILURE, "Index", constant, "out of bounds of", dereference(state.currentFile, line, array->out));
+        out = array->out;
+        out.offset += var->getElementAddress(constant);
+        out.elementSize = (int) type->getSizeSumOfChildSymbols();
+        return;
+    }
+
+    // the destination is cleared before the walk on the array, so it can't be in the array
+    auto begin = array->out.dereference(state.currentFile, line), end = begin + array->out.size();
+    bool intoDst = writesCell(state, dst, type)
+                   && (dst.dereference(state.currentFile, line) >= end || dst.dereference(state.currentFile, line) + dst.size() <= begin);
+    out = intoDst ? dst : state.symbolTable.newTmpVariable(line, type);
+    state.symbolTable.push(*state.symbolTable.newTmpStackframe(line));
+    auto cell = compileArrayIndex(state, this);
+    outputArrayInstruction(state.currentFile, line, state, InstructionName::ARRAY_READ, array->out, cell, out);
+    state.symbolTable.pop();
+}
+
+void IndexExpression::compileStore(CompilationState &state, const SymbolResolutionResult &value) {
+    array->compile(state);
+    auto var = asArray(state.currentFile, line, array->out);
+    if (var->type != asVariable(state.currentFile, line, value)->type || value.size() != var->type->getSizeSumOfChildSymbols())
+        die(state.currentFile, line, EXIT_FAILURE, "Type mismatch between element of", dereference(state.currentFile, line, array->out), "and", dereference(state.currentFile, line, value));
+    state.symbolTable.push(*state.symbolTable.newTmpStackframe(line));
+    auto cell = compileArrayIndex(state, this);
+    outputArrayInstruction(state.currentFile, line, state, InstructionName::ARRAY_WRITE, array->out, cell, value);
+    state.symbolTable.pop();
+}
+
+IndexExpression::~IndexExpression() {
+    delete array;
+    array = nullptr;
+    delete index;
+    index = nullptr;
+}
+
+IndexExpression::IndexExpression(Expression *array, Expression *index)
+        : array(array), index(index) {}
+
 void CallExpression::compile(CompilationState &state) {
+    // divmod(n, d) is computed in place, unless a function of that name is defined
+    auto id = dynamic_cast<IdentifierExpression*>(fun);
+    if (id != nullptr && *id->identifier == "divmod" && !state.symbolTable.findGlobal(QualifiedName{"divmod"})) {
+        compileDivmod(state);
+        return;
+    }
+
     fun->compile(state);
-    auto asfun = asFunction(file, line, fun->out);
+    auto asfun = asFunction(state.currentFile, line, fun->out);
+
+    // A call in tail position with the same return values reuses the frame of the calling function
+    auto caller = state.symbolTable.currentScope()->getParentFunctionStackframe();
+    bool tail = tailCall && caller != nullptr && caller != state.main
+                && caller->returnValues.size() == asfun->returnValues.size()
+                && (asfun->returnValues.empty()
+                    || (asfun->returnValues.size() == 1 && dst == caller->returnValues[0]
+                        && asVariable(state.currentFile, line, dst)->type == asVariable(state.currentFile, line, asfun->returnValues[0])->type
+                        && dst.size() == asfun->returnValues[0].size()));
 
     // Create accessable variables for the return values
-    for (auto &retvar : asfun->returnValues)
-        returnValuesToPop.push_back(state.symbolTable.newTmpVariable(line, asVariable(file, line, retvar)->type));
+    auto frameEnd = state.symbolTable.currentScope()->getCurrentAddressOfFunctionStackframeEnd();
+    if (tail) {
+        // the callee writes the return values of the caller
+        if (dst)
+            returnValuesToPop.push_back(dst);
+    } else if (state.moveLastUse && dst && !dst.resolved->temp && asfun->returnValues.size() == 1
+        && asVariable(state.currentFile, line, dst)->type == asVariable(state.currentFile, line, asfun->returnValues[0])->type
+        && dst.size() == asfun->returnValues[0].size()
+        && dst.dereference(state.currentFile, line) + dst.size() == frameEnd) {
+        // the destination is the last live variable, so the callee can return directly into it
+        returnValuesToPop.push_back(dst);
+    } else {
+        for (auto &retvar : asfun->returnValues)
+            // the return values have to be directly before the callee's stackframe
+            returnValuesToPop.push_back(newTmpLike(state, line, asVariable(state.currentFile, line, retvar), "__tmp"));
+    }
     // use the first return value as default output in expressions
     if (returnValuesToPop.size() > 0)
         out = returnValuesToPop.front();
 
+    // prepare the expressions for each argument, depending on if the argument list is a tuple or not
+    std::vector<Expression*> argumentExprVec;
+    auto astuple = dynamic_cast<TupleExpression*>(arguments);
+    if (astuple != nullptr) argumentExprVec = astuple->tuple;
+    else if (arguments != nullptr) argumentExprVec.push_back(arguments);
+
+    if (argumentExprVec.size() != asfun->parameters.size() - (asfun->memberOf != nullptr ? 1 : 0))
+        die(state.currentFile, line, EXIT_FAILURE, "Expected", asfun->parameters.size() - (asfun->memberOf != nullptr ? 1 : 0), "arguments, but got", argumentExprVec.size());
+
     state.symbolTable.push(*state.symbolTable.newTmpStackframe(line));
 
     // reserve space for the return variable
-    state.symbolTable.initFunctionStackframe(file, line, true);
+    state.symbolTable.initFunctionStackframe(state.currentFile, line, true);
+
+    auto calleeReturnCell = (int) state.symbolTable.findGlobal(QualifiedName{"__ret"}).dereference(state.currentFile, line);
+
+    // A variable, that the callee only reads, is moved into the parameter and back after the call instead of being
+    // copied. Its cells are empty meanwhile, so no later argument and no return value may use them. The dispatcher
+    // clears the two cells after the return cell, when the callee returns, so these are still copied.
+    vector<Instruction> restores;
+    auto lend = [&](const SymbolResolutionResult &parameter, const SymbolResolutionResult &value, size_t index,
+                    const IdentifierExpression *base, size_t next) {
+        auto address = (int) parameter.dereference(state.currentFile, line);
+        auto source = (int) value.dereference(state.currentFile, line);
+        auto copied = std::max(calleeReturnCell + 3 - address, 0);
+        if (tail || base == nullptr || !asfun->readOnly[index] || copied >= (int) value.size())
+            return false;
+        for (auto k = next; k < argumentExprVec.size(); k++)
+            if (mentions(argumentExprVec[k], *base->identifier))
+                return false;
+        for (auto &ret : returnValuesToPop)
+            if ((int) ret.dereference(state.currentFile, line) < source + (int) value.size() && source < (int) (ret.dereference(state.currentFile, line) + ret.size()))
+                return false;
 
-    auto calleeReturnCell = (int) state.symbolTable.findGlobal(QualifiedName{"__ret"}).dereference(file, line);
+        state.symbolTable.push(*state.symbolTable.newTmpStackframe(line));
+        auto aux = (int) state.symbolTable.newTmpVariable(line, state.cellType).dereference(state.currentFile, line);
+        for (int c = 0; c < copied; c++)
+            outputCopyInstruction(state.currentFile, line, state, address + c, source + c, aux);
+        state.symbolTable.pop();
+        Instruction move(state.currentFile, line, InstructionName::MOVE, dereference(state.currentFile, line, parameter) + " " + dereference(state.currentFile, line, value));
+        move.move.dst = address + copied;
+        move.move.src = source + copied;
+        move.move.size = (int) value.size() - copied;
+        outputInstruction(state, move);
+        std::swap(move.move.dst, move.move.src);
+        move.comment = dereference(state.currentFile, line, value) + " " + dereference(state.currentFile, line, parameter);
+        restores.push_back(move);
+        return true;
+    };
 
     // handle 'this' semantic, if function is a member of a type
     if (asfun->memberOf) {
@@ -740,44 +2320,42 @@ void CallExpression::compile(CompilationState &state) {
         auto thisObject = state.symbolTable.findGlobal(QualifiedName{fun->out.resolutionPath[0]->name});
         for (int i = 1; i < fun->out.resolutionPath.size() - 1; i++)
             thisObject.find(fun->out.resolutionPath[i]->name);
+        thisObject.lastUse = fun->out.lastUse;
         // create the parameter variable for the 'this' object
-        auto thisVariable = state.symbolTable.newTmpVariable(line, asVariable(file, line, thisObject)->type, -1, "__this");
+        auto thisVariable = state.symbolTable.newTmpVariable(line, asVariable(state.currentFile, line, thisObject)->type, -1, "__this", false);
         if (fun->out.resolutionPath.size() < 2)
-            die(file, line, EXIT_FAILURE, "Member function not called by a member");
+            die(state.currentFile, line, EXIT_FAILURE, "Member function not called by a member");
         // Create temporary variable and stackframe, needed for copying this object
-        if (thisObject.resolved->temp) {
-            outputMoveInstruction(file, line, BinaryOperatorExpression::OP_MOV, thisVariable, thisObject);
-        } else {
+        if (thisObject.resolved->temp || thisObject.lastUse) {
+            outputMoveInstruction(state.currentFile, line, state, BinaryOperatorExpression::OP_MOV, thisVariable, thisObject);
+            state.symbolTable.release(thisObject);
+        } else if (!lend(thisVariable, thisObject, 0, baseIdentifier(fun), 0)) {
             state.symbolTable.push(*state.symbolTable.newTmpStackframe(line));
             auto tempvar = state.symbolTable.newTmpVariable(line, state.cellType);
-            outputCopyInstruction(file, line, BinaryOperatorExpression::OP_MOV, thisVariable, thisObject, tempvar);
+            outputCopyInstruction(state.currentFile, line, state, BinaryOperatorExpression::OP_MOV, thisVariable, thisObject, tempvar);
             state.symbolTable.pop();
         }
     }
 
-    // prepare the expressions for each argument, depending on if the argument list is a tuple or not
-    std::vector<Expression*> argumentExprVec;
-    auto astuple = dynamic_cast<TupleExpression*>(arguments);
-    if (astuple != nullptr) argumentExprVec = astuple->tuple;
-    else if (arguments != nullptr) argumentExprVec.push_back(arguments);
-
-    if (argumentExprVec.size() != asfun->parameters.size() - (asfun->memberOf != nullptr ? 1 : 0))
-        die(file, line, EXIT_FAILURE, "Expected", asfun->parameters.size() - (asfun->memberOf != nullptr ? 1 : 0), "arguments, but got", argumentExprVec.size());
-
     for (int i = 0; i < asfun->parameters.size() - (asfun->memberOf != nullptr ? 1 : 0); i++) {
         auto argvar = asfun->parameters[i + (asfun->memberOf != nullptr ? 1 : 0)];
         auto argexpr = argumentExprVec[i];
-        argumentsToPush.push_back(state.symbolTable.newTmpVariable(line, asVariable(file, line, argvar)->type, -1, "__arg"));
+        argumentsToPush.push_back(newTmpLike(state, line, asVariable(state.currentFile, line, argvar), "__arg"));
         auto argframe = state.symbolTable.newTmpStackframe(line);
         state.symbolTable.push(*argframe);
+        if (loadConstant(state, argexpr, argumentsToPush.back())) {
+            state.symbolTable.pop();
+            continue;
+        }
         argexpr->compile(state);
-        if (argexpr->out.resolved->temp) {
+        if (argexpr->out.resolved->temp || argexpr->out.lastUse) {
             // push argument expression on top of the stack
-            outputMoveInstruction(file, line, BinaryOperatorExpression::OP_MOV, argumentsToPush.back(), argexpr->out);
-        } else {
+            outputMoveInstruction(state.currentFile, line, state, BinaryOperatorExpression::OP_MOV, argumentsToPush.back(), argexpr->out);
+            state.symbolTable.release(argexpr->out);
+        } else if (!lend(argumentsToPush.back(), argexpr->out, i + (asfun->memberOf != nullptr ? 1 : 0), baseIdentifier(argexpr), i + 1)) {
             // copy the variable before pushing it on the stack
             auto tempvar = state.symbolTable.newTmpVariable(line, state.cellType);
-            outputCopyInstruction(file, line, BinaryOperatorExpression::OP_MOV, argumentsToPush.back(), argexpr->out,
+            outputCopyInstruction(state.currentFile, line, state, BinaryOperatorExpression::OP_MOV, argumentsToPush.back(), argexpr->out,
                                   tempvar);
         }
         state.symbolTable.pop();
@@ -787,14 +2365,70 @@ void CallExpression::compile(CompilationState &state) {
 
     state.symbolTable.pop();
 
-    Instruction call(file, line, InstructionName::CALL, asfun->name);
+    if (tail) {
+        // move 'this' and the arguments over the parameters of the caller, cell by cell from the lowest one,
+        // because both ranges may overlap
+        auto parameters = (int) caller->returnValues.size() > 0
+                          ? (int) caller->returnValues.back().dereference(state.currentFile, line) + (int) caller->returnValues.back().size() + 1
+                          : 1;
+        for (int c = 0; c < calleeArgumentsEnd - calleeReturnCell - 1; c++)
+            outputMoveInstruction(state.currentFile, line, state, parameters + c, calleeReturnCell + 1 + c);
+        // the callee's label moves the stack base back to the caller's frame, the caller's return address stays
+        outputJumpInstruction(state.currentFile, line, state, parameters + calleeArgumentsEnd - calleeReturnCell - 1, asfun->address,
+                              asfun->name + "@" + to_string(asfun->address));
+        return;
+    }
+
+    Instruction call(state.currentFile, line, InstructionName::CALL, asfun->name);
     call.call.returnCell = calleeReturnCell;
-    call.call.returnAddress = ++jumpAddressCounter;
-    outputInstruction(call);
+    call.call.returnAddress = state.newJumpAddress();
+    // the callee's frame starts after the arguments and is still free
+    call.call.aux = calleeArgumentsEnd;
+    outputInstruction(state, call);
 
-    outputJumpInstruction(file, line, calleeArgumentsEnd, asfun->address, asfun->name + "@" + to_string(asfun->address));
+    outputJumpInstruction(state.currentFile, line, state, calleeArgumentsEnd, asfun->address, asfun->name + "@" + to_string(asfun->address));
     // create the label, the callee will jump back to
-    outputLabelInstruction(file, line, calleeReturnCell, call.call.returnAddress, "ret-" + asfun->name);
+    outputLabelInstruction(state.currentFile, line, state, calleeReturnCell, call.call.returnAddress, "ret-" + asfun->name);
+
+    // take the lent variables back from the parameters
+    for (auto &restore : restores)
+        outputInstruction(state, restore);
+}
+
+void CallExpression::compileDivmod(CompilationState &state) {
+    auto astuple = dynamic_cast<TupleExpression*>(arguments);
+    if (astuple == nullptr || astuple->tuple.size() != 2)
+        die(state.currentFile, line, EXIT_FAILURE, "Expected 2 arguments, but got", astuple != nullptr ? (int) astuple->tuple.size() : (arguments != nullptr ? 1 : 0));
+    auto value = astuple->tuple[0], factor = astuple->tuple[1];
+
+    // the quotient and the remainder are adjacent like the return values of a function
+    returnValuesToPop.push_back(state.symbolTable.newTmpVariable(line, state.cellType, -1, "__tmp", false));
+    returnValuesToPop.push_back(state.symbolTable.newTmpVariable(line, state.cellType, -1, "__tmp", false));
+    out = returnValuesToPop.front();
+
+    state.symbolTable.push(*state.symbolTable.newTmpStackframe(line));
+    value->dst = out;
+    value->compile(state);
+    checkType(state.currentFile, line, out, value->out);
+    checkReturnsValue(state.currentFile, line, value);
+    outputAutoMoveInstruction(state.currentFile, line, state, BinaryOperatorExpression::OP_MOV, out, value->out);
+    state.symbolTable.pop();
+
+    state.symbolTable.push(*state.symbolTable.newTmpStackframe(line));
+    cellValue constant;
+    if (evaluateConstant(state, factor, constant)) {
+        if (state.wrap(constant) == 0)
+            die(state.currentFile, line, EXIT_FAILURE, "Division by zero");
+        auto scratch = state.symbolTable.newTmpVariable(line, state.cellType, 6, "__scratch");
+        outputArithmeticInstruction(state.currentFile, line, state, BinaryOperatorExpression::OP_DIV, out, state.wrap(constant), scratch, true);
+    } else {
+        factor->compile(state);
+        checkType(state.currentFile, line, out, factor->out);
+        checkReturnsValue(state.currentFile, line, factor);
+        auto scratch = state.symbolTable.newTmpVariable(line, state.cellType, 6, "__scratch");
+        outputArithmeticInstruction(state.currentFile, line, state, BinaryOperatorExpression::OP_DIV, out, factor->out, scratch, true);
+    }
+    state.symbolTable.pop();
 }
 
 CallExpression::~CallExpression() {
@@ -846,18 +2480,22 @@ void VariableDefinition::compile(CompilationState &state) {
     if (type != nullptr) {
         auto result = state.symbolTable.findGlobal(*type->typeName);
         if (!result)
-            die(file, line, EXIT_FAILURE, "Undefined type: " + joinQualified(*type->typeName));
+            die(state.currentFile, line, EXIT_FAILURE, "Undefined type: " + joinQualified(*type->typeName));
         astype = dynamic_cast<TypeSymbol*>(result.resolved);
 
         if (astype == nullptr)
-            die(file, line, EXIT_FAILURE, "Expected type, found " + symbol2str(*result.resolved) + " " + joinQualified(*type->typeName));
+            die(state.currentFile, line, EXIT_FAILURE, "Expected type, found " + symbol2str(*result.resolved) + " " + joinQualified(*type->typeName));
+        // the carries wrap at the width of a cell, a wider cell would not wrap at 16 bits
+        if (astype == state.u16Type && state.cellBits > 16)
+            die(state.currentFile, line, EXIT_FAILURE, "Type u16 needs cells of at most 16 bits, found --cell-bits", state.cellBits);
     }
 
-    variableSymbol = new VariableSymbol(line, file, *name, astype);
+    variableSymbol = state.symbolTable.create<VariableSymbol>(line, state.currentFile, *name, astype);
 
     if (type != nullptr) {
         variableSymbol->length = type->length;
         variableSymbol->isPointerType = type->type != VariableType::STACK;
+        variableSymbol->isArray = type->type == VariableType::FIXED;
     }
 
     state.symbolTable.add(*variableSymbol);
@@ -876,7 +2514,7 @@ VariableDefinition::VariableDefinition(VariableType *type, string *name)
         : type(type), name(name) {}
 
 void TypeStatement::compile(CompilationState &state) {
-    auto newtype = new TypeSymbol(line, file, *name);
+    auto newtype = state.symbolTable.create<TypeSymbol>(line, state.currentFile, *name);
     state.symbolTable.add(*newtype);
     state.symbolTable.push(*newtype);
     for (auto var : *variables)
@@ -894,12 +2532,19 @@ TypeStatement::~TypeStatement() {
 }
 
 void FunctionStatement::compile(CompilationState &state) {
-    auto functionSymbol = new FunctionSymbol(line, file, qualifiedName->back(), ++jumpAddressCounter);
+    auto functionSymbol = state.symbolTable.create<FunctionSymbol>(line, state.currentFile, qualifiedName->back(), state.newJumpAddress());
+    functionSymbol->isInline = isInline;
+    state.functions.push_back(functionSymbol);
+
+    // nested functions get their own instruction list
+    auto enclosingCode = state.currentCode;
+    auto enclosingReachable = state.reachable;
+    state.currentCode = &functionSymbol->code;
 
     // register main function if applicable
     if (state.symbolTable.scopeStack.size() == 1 && qualifiedName->back() == "main") {
         if (state.main != nullptr)
-            die(file, line, EXIT_FAILURE, "Main function already defined here:", *state.main);
+            die(state.currentFile, line, EXIT_FAILURE, "Main function already defined here:", *state.main);
         state.main = functionSymbol;
     }
 
@@ -909,9 +2554,9 @@ void FunctionStatement::compile(CompilationState &state) {
         extendedScope.pop_back();
         auto exScopeResult = state.symbolTable.findGlobal(extendedScope);
         if (!exScopeResult)
-            die(file, line, EXIT_FAILURE, "Can't extend scope " + joinQualified(extendedScope) + " with function " + qualifiedName->back());
+            die(state.currentFile, line, EXIT_FAILURE, "Can't extend scope " + joinQualified(extendedScope) + " with function " + qualifiedName->back());
         if (dynamic_cast<const TypeSymbol*>(exScopeResult.resolved) == nullptr)
-            die(file, line, EXIT_FAILURE, "Only types are extendable, but this extends", symbol2str(*exScopeResult.resolved));
+            die(state.currentFile, line, EXIT_FAILURE, "Only types are extendable, but this extends", symbol2str(*exScopeResult.resolved));
         state.symbolTable.push(*exScopeResult.resolved);
         functionSymbol->memberOf = exScopeResult.resolved;
     }
@@ -928,7 +2573,7 @@ void FunctionStatement::compile(CompilationState &state) {
     }
 
     // create the function stack base variables
-    state.symbolTable.initFunctionStackframe(file, line, false);
+    state.symbolTable.initFunctionStackframe(state.currentFile, line, false);
 
     // create all parameters
     if (parameterVariables != nullptr) {
@@ -942,7 +2587,9 @@ void FunctionStatement::compile(CompilationState &state) {
     auto endOfStack = static_cast<int>(state.symbolTable.currentScope()->getCurrentAddressOfFunctionStackframeEnd());
 
     // create the function label
-    outputLabelInstruction(file, line, endOfStack, functionSymbol->address, joinQualified(functionSymbol->getQualified()));
+    outputLabelInstruction(state.currentFile, line, state, endOfStack, functionSymbol->address, joinQualified(functionSymbol->getQualified()));
+    for (auto &retvar : functionSymbol->returnValues)
+        outputArrayClearInstruction(state.currentFile, line, state, asVariable(state.currentFile, line, retvar), (int) retvar.dereference(state.currentFile, line));
 
     // prevent the list from creating a temporary stackframe by registering the parent function
     auto *functionBodyList = dynamic_cast<ListStatement*>(functionBody);
@@ -950,9 +2597,16 @@ void FunctionStatement::compile(CompilationState &state) {
         functionBodyList->function = functionSymbol;
 
     // compile the function
+    LastUseAnalysis analysis(state.moveLastUse);
+    analysis.run(*this);
+    // a tail call moves its arguments over the parameters
+    bool tailCalls = state.tailCalls && state.main != functionSymbol && markTailCalls(functionBody);
+    if (parameterVariables != nullptr)
+        for (auto var : *parameterVariables)
+            functionSymbol->readOnly.push_back(state.lendArguments && !tailCalls && analysis.isReadOnly(var));
     functionBody->compile(state);
 
-    auto returnRegisterAddress = (int) state.symbolTable.findGlobal(QualifiedName{"__ret"}).dereference(file, line);
+    auto returnRegisterAddress = (int) state.symbolTable.findGlobal(QualifiedName{"__ret"}).dereference(state.currentFile, line);
     // pop the function scope
     state.symbolTable.pop();
 
@@ -960,10 +2614,13 @@ void FunctionStatement::compile(CompilationState &state) {
     if (functionSymbol->memberOf != nullptr)
         state.symbolTable.pop();
 
-    Instruction ret(file, line, InstructionName::RET, functionSymbol->name);
+    Instruction ret(state.currentFile, line, InstructionName::RET, functionSymbol->name);
     ret.ret.ret = returnRegisterAddress;
     ret.ret.exit = functionSymbol->name == "main";
-    outputInstruction(ret);
+    outputInstruction(state, ret);
+
+    state.currentCode = enclosingCode;
+    state.reachable = enclosingReachable;
 }
 
 FunctionStatement::~FunctionStatement() {
@@ -1002,18 +2659,30 @@ size_t TypeSymbol::getSizeSumOfChildSymbols() const {
 }
 
 size_t VariableSymbol::getSizeSumOfChildSymbols() const {
+    if (isArray)
+        return getElementStride() * (length + 1);
     return type->getSizeSumOfChildSymbols() * length;
 }
 
+size_t VariableSymbol::getElementStride() const {
+    return 2 * type->getSizeSumOfChildSymbols() + 1;
+}
+
+size_t VariableSymbol::getElementAddress(cellValue index) const {
+    return getElementStride() * (index + 1) + 1 + type->getSizeSumOfChildSymbols();
+}
+
 size_t VariableSymbol::getSizeOnTheStack() const {
     return getSizeSumOfChildSymbols();
 }
 
 size_t VariableSymbol::getAddressRelativeToParent() const {
+    if (addressInParent != size_t(-1))
+        return addressInParent;
     size_t loc = 0;
     for (auto s : parent->symbols) {
         if (s == this)
-            return loc;
+            return addressInParent = loc;
         loc += s->getSizeOnTheStack();
     }
     die(file, line, EXIT_FAILURE, "No location for variable found");
@@ -1048,10 +2717,7 @@ size_t StackframeSymbol::getSizeSumOfChildSymbols() const {
 }
 
 size_t StackframeSymbol::getAddressRelativeToParent() const {
-    size_t loc = 0;
-    for (auto s : parent->symbols)
-        loc += s->getSizeOnTheStack();
-    return loc;
+    return offset;
 }
 
 size_t StackframeSymbol::getAddressRelativeToFunctionStackframe() const {
@@ -1071,17 +2737,20 @@ size_t SymbolResolutionResult::dereference(const string &file, int line) const {
         if (asvar != nullptr)
             adr += asvar->getAddressRelativeToFunctionStackframe();
     }
-    return adr;
+    return adr + offset;
 }
 
-SymbolResolutionResult &SymbolResolutionResult::find(string name) {
-    resolved = nullptr;
-    for (auto s : scope->getScope()->symbols) {
-        if (s->name == name) {
-            scope = s;
-            resolved = s;
-            resolutionPath.push_back(s);
-        }
+size_t SymbolResolutionResult::size() const {
+    return elementSize >= 0 ? (size_t) elementSize : resolved->getSizeOnTheStack();
+}
+
+SymbolResolutionResult &SymbolResolutionResult::find(const string &name) {
+    resolved = scope->getScope()->findChild(name);
+    if (resolved != nullptr) {
+        scope = resolved;
+        resolutionPath.push_back(resolved);
+        // a member of an element keeps the offset of the element
+        elementSize = -1;
     }
     return *this;
 }
@@ -1108,9 +2777,9 @@ std::string SymbolResolutionResult::name() const {
 }
 
 void IfStatement::compile(CompilationState &state) {
-    auto trueLabel = ++jumpAddressCounter;
-    auto falseLabel = onFalse != nullptr ? ++jumpAddressCounter : -1;
-    auto fiLabel = ++jumpAddressCounter;
+    auto trueLabel = state.newJumpAddress();
+    auto falseLabel = onFalse != nullptr ? state.newJumpAddress() : -1;
+    auto fiLabel = state.newJumpAddress();
 
     state.symbolTable.push(*state.symbolTable.newTmpStackframe(line));
     condition->compile(state);
@@ -1118,28 +2787,29 @@ void IfStatement::compile(CompilationState &state) {
     auto jumpRegister = (int) state.symbolTable.currentScope()->getCurrentAddressOfFunctionStackframeEnd();
 
     if (!condition->out)
-        die(file, line, EXIT_FAILURE, "Invalid conditional");
+        die(state.currentFile, line, EXIT_FAILURE, "Invalid conditional");
 
     if (onFalse != nullptr)
-        outputTestInstruction(file, line, condition->out, jumpRegister, trueLabel, falseLabel);
+        outputTestInstruction(state.currentFile, line, state, condition->out, jumpRegister, trueLabel, falseLabel);
     else
-        outputTestInstruction(file, line, condition->out, jumpRegister, trueLabel, fiLabel);
+        outputTestInstruction(state.currentFile, line, state, condition->out, jumpRegister, trueLabel, fiLabel);
+    state.symbolTable.release(condition->out);
 
-    outputLabelInstruction(file, line, jumpRegister, trueLabel, "IF_TRUE");
+    outputLabelInstruction(state.currentFile, line, state, jumpRegister, trueLabel, "IF_TRUE");
     state.symbolTable.push(*state.symbolTable.newTmpStackframe(line));
     onTrue->compile(state);
     state.symbolTable.pop();
-    outputJumpInstruction(file, line, jumpRegister, fiLabel, "FI");
+    outputJumpInstruction(state.currentFile, line, state, jumpRegister, fiLabel, "FI");
 
     if (onFalse != nullptr) {
-        outputLabelInstruction(file, line, jumpRegister, falseLabel, "IF_FALSE");
+        outputLabelInstruction(state.currentFile, line, state, jumpRegister, falseLabel, "IF_FALSE");
         state.symbolTable.push(*state.symbolTable.newTmpStackframe(line));
         onFalse->compile(state);
         state.symbolTable.pop();
-        outputJumpInstruction(file, line, jumpRegister, fiLabel, "FI");
+        outputJumpInstruction(state.currentFile, line, state, jumpRegister, fiLabel, "FI");
     }
 
-    outputLabelInstruction(file, line, jumpRegister, fiLabel, "FI");
+    outputLabelInstruction(state.currentFile, line, state, jumpRegister, fiLabel, "FI");
 }
 
 IfStatement::~IfStatement() {
@@ -1156,40 +2826,37 @@ IfStatement::IfStatement(Expression *condition, Statement *onTrue, Statement *on
 
 
 void WhileStatement::compile(CompilationState &state) {
-    // label for where the condition is evaluated
-    auto conditionLabel = ++jumpAddressCounter;
     // label for where the body is evaluated
-    auto trueLabel = ++jumpAddressCounter;
+    auto trueLabel = state.newJumpAddress();
     // label for after the condition is false
-    auto falseLabel = ++jumpAddressCounter;
+    auto falseLabel = state.newJumpAddress();
     // address for registers required to for jump
     auto jump_register = (int) state.symbolTable.currentScope()->getCurrentAddressOfFunctionStackframeEnd();
 
-    // jump to the condition for the first time
-    outputJumpInstruction(file, line, jump_register, conditionLabel, "WHILE");
-
-    // create label for the condition
-    outputLabelInstruction(file, line, jump_register, conditionLabel, "WHILE_CONDITION");
-
-    // evaluate the condition
-    state.symbolTable.push(*state.symbolTable.newTmpStackframe(line));
-    condition->compile(state);
-    state.symbolTable.pop();
+    // evaluates the condition and jumps according to its result
+    auto test = [&] {
+        state.symbolTable.push(*state.symbolTable.newTmpStackframe(line));
+        condition->compile(state);
+        state.symbolTable.pop();
+        outputTestInstruction(state.currentFile, line, state, condition->out, jump_register, trueLabel, falseLabel);
+        state.symbolTable.release(condition->out);
+    };
 
-    // jump according to the conditions result
-    outputTestInstruction(file, line, condition->out, jump_register, trueLabel, falseLabel);
+    // the loop is compiled as 'if (c) do body while (c)': the condition is tested before the loop and again at the
+    // end of the body, so an iteration goes through the dispatcher once instead of jumping back to the condition
+    test();
     // create label for the body
-    outputLabelInstruction(file, line, jump_register, trueLabel, "WHILE_BODY");
+    outputLabelInstruction(state.currentFile, line, state, jump_register, trueLabel, "WHILE_BODY");
 
     // evaluate the body
     state.symbolTable.push(*state.symbolTable.newTmpStackframe(line));
     body->compile(state);
     state.symbolTable.pop();
 
-    // jump back to evaluate the condition
-    outputJumpInstruction(file, line, jump_register, conditionLabel, "WHILE_CONDITION");
+    resetExpression(condition);
+    test();
     // label for when the condition is false
-    outputLabelInstruction(file, line, jump_register, falseLabel, "WHILE_FALSE");
+    outputLabelInstruction(state.currentFile, line, state, jump_register, falseLabel, "WHILE_FALSE");
 }
 
 WhileStatement::~WhileStatement() {
@@ -1227,7 +2894,7 @@ TupleExpression::TupleExpression(Expression *lhs, Expression *rhs) {
 }
 
 void TupleExpression::compile(CompilationState &state) {
-    errprintln(file + ":" + to_string(line), "TUPLE");
+    errprintln(state.currentFile + ":" + to_string(line), "TUPLE");
     assert(false);
 }
 
@@ -1239,27 +2906,33 @@ TupleExpression::~TupleExpression() {
 void ReturnStatement::compile(CompilationState &state) {
     auto fun = state.symbolTable.currentScope()->getParentFunctionStackframe();
     if (fun == nullptr)
-        die(file, line, EXIT_FAILURE, "Return outside of function");
+        die(state.currentFile, line, EXIT_FAILURE, "Return outside of function");
     if (expr != nullptr) {
         auto astuple = dynamic_cast<TupleExpression*>(expr);
 
         // return action if returning multiple values
         if (astuple != nullptr) {
             if (astuple->tuple.size() != fun->returnValues.size())
-                die(file, line, EXIT_FAILURE, "Too", astuple->tuple.size() < fun->returnValues.size()  ? "few" : "many", "values to return", "(" + to_string(astuple->tuple.size()), "vs.", to_string(fun->returnValues.size()) + ")");
+                die(state.currentFile, line, EXIT_FAILURE, "Too", astuple->tuple.size() < fun->returnValues.size()  ? "few" : "many", "values to return", "(" + to_string(astuple->tuple.size()), "vs.", to_string(fun->returnValues.size()) + ")");
             int i = 0;
             for (auto e : astuple->tuple) {
                 // pair each return expression with it's corresponding return variable
                 auto tmp = state.symbolTable.newTmpStackframe(line);
                 state.symbolTable.push(*tmp);
+                if (loadConstant(state, e, fun->returnValues[i])) {
+                    i += 1;
+                    state.symbolTable.pop();
+                    continue;
+                }
                 e->compile(state);
                 if (!e->out)
-                    die(file, line, EXIT_FAILURE, "Undefined return value");
-                if (e->out.resolved->temp) {
-                    outputMoveInstruction(file, line, BinaryOperatorExpression::OP_MOV, fun->returnValues[i], e->out);
+                    die(state.currentFile, line, EXIT_FAILURE, "Undefined return value");
+                if (e->out.resolved->temp || e->out.lastUse) {
+                    outputMoveInstruction(state.currentFile, line, state, BinaryOperatorExpression::OP_MOV, fun->returnValues[i], e->out);
+                    state.symbolTable.release(e->out);
                 } else {
                     auto tmpvar = state.symbolTable.newTmpVariable(line, state.cellType);
-                    outputCopyInstruction(file, line, BinaryOperatorExpression::OP_MOV, fun->returnValues[i], e->out,
+                    outputCopyInstruction(state.currentFile, line, state, BinaryOperatorExpression::OP_MOV, fun->returnValues[i], e->out,
                                           tmpvar);
                 }
                 i += 1;
@@ -1268,19 +2941,21 @@ void ReturnStatement::compile(CompilationState &state) {
         } else {
             // return action if returning single value
             if (fun->returnValues.empty())
-                die(file, line, EXIT_FAILURE, "The function does not return a value");
+                die(state.currentFile, line, EXIT_FAILURE, "The function does not return a value");
 //            else if (fun->returnValues.size() > 1)
-//                die(file, line, EXIT_FAILURE, "Too many values to return", "(1 vs.", to_string(fun->returnValues.size()) + ")");
+//                die(state.currentFile, line, EXIT_FAILURE, "Too many values to return", "(1 vs.", to_string(fun->returnValues.size()) + ")");
             auto tmp = state.symbolTable.newTmpStackframe(line);
             state.symbolTable.push(*tmp);
+            expr->dst = fun->returnValues[0];
             expr->compile(state);
             if (!expr->out)
-                die(file, line, EXIT_FAILURE, "Undefined return value");
-            if (expr->out.resolved->temp) {
-                outputMoveInstruction(file, line, BinaryOperatorExpression::OP_MOV, fun->returnValues[0], expr->out);
+                die(state.currentFile, line, EXIT_FAILURE, "Undefined return value");
+            if (expr->out.resolved->temp || expr->out.lastUse) {
+                outputMoveInstruction(state.currentFile, line, state, BinaryOperatorExpression::OP_MOV, fun->returnValues[0], expr->out);
+                state.symbolTable.release(expr->out);
             } else {
                 auto tmpvar = state.symbolTable.newTmpVariable(line, state.cellType);
-                outputCopyInstruction(file, line, BinaryOperatorExpression::OP_MOV, fun->returnValues[0], expr->out,
+                outputCopyInstruction(state.currentFile, line, state, BinaryOperatorExpression::OP_MOV, fun->returnValues[0], expr->out,
                                       tmpvar);
             }
             state.symbolTable.pop();
@@ -1302,29 +2977,60 @@ void IOStatement::compile(CompilationState &state) {
     if (astuple != nullptr) {
         for (auto e : astuple->tuple) {
             state.symbolTable.push(*state.symbolTable.newTmpStackframe(line));
-            e->compile(state);
-            if (!e->out)
-                die(file, line, EXIT_FAILURE, "No destination found");
-            if (e->out.resolved->temp && function == IOFunction::IOINPUT)
-                die(file, line, EXIT_FAILURE, "Input destination can't be a temporary");
-            outputIoInstruction(file, line, function, e->out);
+            compile(state, e);
             state.symbolTable.pop();
         }
     } else {
-        expr->compile(state);
-        if (!expr->out)
-            die(file, line, EXIT_FAILURE, "No destination found");
-        if (expr->out.resolved->temp && function == IOFunction::IOINPUT)
-            die(file, line, EXIT_FAILURE, "Input destination can't be a temporary");
-        outputIoInstruction(file, line, function, expr->out);
+        compile(state, expr);
     }
     state.symbolTable.pop();
 }
 
+void IOStatement::compile(CompilationState &state, Expression *e) {
+    auto asstring = dynamic_cast<StringExpression*>(e);
+    if (asstring != nullptr && !isInput()) {
+        // print string literals through a single cell instead of loading the whole string
+        std::string parsed = parseStringEscape(*asstring->string);
+        if (parsed.empty())
+            return;
+        auto cell = state.symbolTable.newTmpVariable(line, state.cellType);
+        auto aux = (int) state.symbolTable.currentScope()->getCurrentAddressOfFunctionStackframeEnd();
+        outputPrintStringInstruction(state.currentFile, line, state, cell, parsed, aux);
+        return;
+    }
+    // input into an element at a runtime index is read into a temporary, that is stored into the array
+    auto index = dynamic_cast<IndexExpression*>(e);
+    if (index != nullptr && isInput() && !index->isConstant(state)) {
+        auto value = state.symbolTable.newTmpVariable(line, expressionType(state, e));
+        if (function == IOFunction::IODECIMALINPUT) {
+            auto scratch = state.symbolTable.newTmpVariable(line, state.cellType, decimalScratchSize(state, function), "__scratch");
+            outputIoInstruction(state.currentFile, line, state, function, value, (int) scratch.dereference(state.currentFile, line));
+            state.symbolTable.release(scratch);
+        } else {
+            outputIoInstruction(state.currentFile, line, state, function, value);
+        }
+        index->compileStore(state, value);
+        state.symbolTable.release(value);
+        return;
+    }
+    e->compile(state);
+    if (!e->out)
+        die(state.currentFile, line, EXIT_FAILURE, "No destination found");
+    if (e->out.resolved->temp && isInput())
+        die(state.currentFile, line, EXIT_FAILURE, "Input destination can't be a temporary");
+    if (function == IOFunction::IODECIMALINPUT || function == IOFunction::IODECIMALOUTPUT) {
+        auto scratch = state.symbolTable.newTmpVariable(line, state.cellType, decimalScratchSize(state, function), "__scratch");
+        outputIoInstruction(state.currentFile, line, state, function, e->out, (int) scratch.dereference(state.currentFile, line));
+    } else {
+        outputIoInstruction(state.currentFile, line, state, function, e->out);
+    }
+    state.symbolTable.release(e->out);
+}
+
 void InlineStatement::compile(CompilationState &state) {
-    Instruction i(file, line, InstructionName::WRITE_INLINE, "inline");
-    i.inline_code.inlineStr = inl->c_str();
-    outputInstruction(i);
+    Instruction i(state.currentFile, line, InstructionName::WRITE_INLINE, "inline");
+    i.inlineStr = *inl;
+    outputInstruction(state, i);
 }
 
 InlineStatement::~InlineStatement() {
@@ -1333,188 +3039,469 @@ InlineStatement::~InlineStatement() {
 }
 
 std::ostream &operator<<(std::ostream &os, const Instruction &i) {
+    switch (i.instr) {
+        case InstructionName::NOP:
+            return os;
+        case InstructionName::PUSH_STACK:
+        case InstructionName::POP_STACK:
+            return osprint(os, i.line, instruction_name_map.at(i.instr), i.stack.offset, i.comment);
+        case InstructionName::LABEL:
+            return osprint(os << endl, i.line, instruction_name_map.at(i.instr), i.comment);
+        case InstructionName::WRITE_INLINE:
+            return osprint(os, i.line, instruction_name_map.at(i.instr), i.inlineStr);
+        case InstructionName::UNINITIALIZED:
+            die(i.file, i.line, EXIT_FAILURE, "Uninitialized instruction");
+            return os;
+        default:
+            return osprint(os, i.line, instruction_name_map.at(i.instr), i.comment);
+    }
+}
+
+void Emitter::emit(const Instruction &i) {
     switch (i.instr) {
         case InstructionName::NOP:
             break;
         case InstructionName::COPY:
         case InstructionName::ADD_COPY:
         case InstructionName::SUB_COPY:
-            if (!i.release || debug)
-                osprint(os, i.line, instruction_name_map.at(i.instr), i.comment);
-            if (i.release) {
-                if (debug)
-                    os << endl;
-                if (i.instr == InstructionName::COPY)
-                    zero(os, i.copy.dst, i.copy.size);
-                if (i.instr == InstructionName::SUB_COPY)
-                    sub(os, i.copy.dst, i.copy.src, i.copy.aux, i.copy.size);
-                else
-                    add(os, i.copy.dst, i.copy.src, i.copy.aux, i.copy.size);
-            }
-            return os;
+            if (i.instr == InstructionName::COPY)
+                zero(i.copy.dst, i.copy.size);
+            copy(i.copy.dst, i.copy.src, i.copy.aux, i.copy.size, i.instr == InstructionName::SUB_COPY ? -1 : 1);
+            break;
         case InstructionName::ILOAD:
         case InstructionName::IADD:
-        case InstructionName::ISUB:
-            if (!i.release || debug)
-                osprint(os, i.line, instruction_name_map.at(i.instr), i.comment);
-            if (i.release) {
-                if (debug) os << endl;
-                if (i.instr == InstructionName::ILOAD)
-                    zero(os, i.constant.dst, i.constant.size);
-                iadd(os, i.constant.dst, i.constant.value, i.constant.size);
-            }
-            return os;
+        case InstructionName::ISUB: {
+            assert(i.constant.size == 1);
+            // the aux cells are only free at this instruction, a constant generated in them is written at once
+            bool eager = i.constant.aux >= 0 && constantCost(i.constant.dst, i.constant.value, i.constant.aux, 2) < std::min(wrap(i.constant.value), state.cellRange() - wrap(i.constant.value));
+            if (eager)
+                flush(i.constant.dst);
+            if (i.instr == InstructionName::ILOAD)
+                zero(i.constant.dst, i.constant.size);
+            iadd(i.constant.dst, i.constant.value, i.constant.aux, 2);
+            if (eager)
+                flush(i.constant.dst);
+            break;
+        }
         case InstructionName::MOVE:
         case InstructionName::ADD:
         case InstructionName::SUB:
-            if (!i.release || debug)
-                osprint(os, i.line, instruction_name_map.at(i.instr), i.comment);
-            if (i.release) {
-                if (debug) os << endl;
-                if (i.instr == InstructionName::MOVE)
-                    zero(os, i.move.dst, i.move.size);
-                if (i.instr == InstructionName::SUB)
-                    sub(os, i.move.dst, i.move.src, i.move.size);
-                else
-                    add(os, i.move.dst, i.move.src, i.move.size);
+            if (i.instr == InstructionName::MOVE)
+                zero(i.move.dst, i.move.size);
+            transfer(i.move.dst, i.move.src, i.move.size, i.instr == InstructionName::SUB ? -1 : 1);
+            break;
+        case InstructionName::ADD_CARRY:
+        case InstructionName::SUB_CARRY:
+            carry(i.copy.dst, i.copy.src, i.copy.size, i.copy.aux, i.instr == InstructionName::SUB_CARRY ? -1 : 1, false);
+            break;
+        case InstructionName::IADD_CARRY: {
+            // aux holds 'a 1 0 c k n': each cell of the constant is loaded into n and added like ADD_CARRY. The cells
+            // below the lowest one, that isn't zero in the constant, don't change, and ones are added without a loop.
+            auto dst = i.constant.dst, a = i.constant.aux, c = a + 3, k = a + 4, n = a + 5;
+            cellValue sign = i.constant.value < 0 ? -1 : 1, value = std::abs(i.constant.value);
+            zero(a, 6);
+            inc(a + 1);
+            bool carried = false;
+            for (int j = 0; j < i.constant.size; j++, value /= state.cellRange()) {
+                auto digit = value % state.cellRange();
+                if (!carried && digit == 0)
+                    continue;
+                if (j == i.constant.size - 1) {
+                    iadd(dst + j, sign * digit);
+                    if (carried)
+                        transfer(dst + j, c, 1, sign);
+                    break;
+                }
+                transfer(a, dst + j, 1);
+                if (carried)
+                    transfer(k, c, 1);
+                if (digit == 1) {
+                    at(a, carryStep(sign));
+                    // the step ends behind the flag, a may have any value
+                    known.clear();
+                } else if (digit > 1) {
+                    // the cell of dst is free to generate the constant
+                    iadd(n, digit, dst + j);
+                    carryLoop(n, a, sign);
+                }
+                if (carried)
+                    carryLoop(k, a, sign);
+                transfer(dst + j, a, 1);
+                carried = true;
             }
-            return os;
+            dec(a + 1);
+            break;
+        }
+        case InstructionName::MUL:
+            // the value is moved out of dst, which gets src added for each unit of it
+            zero(i.copy.aux + 1, 1);
+            transfer(i.copy.aux + 1, i.copy.dst, 1);
+            loop(i.copy.aux + 1, {i.copy.dst, i.copy.src, i.copy.aux}, [&] {
+                dec(i.copy.aux + 1);
+                copy(i.copy.dst, i.copy.src, i.copy.aux, 1);
+            });
+            break;
+        case InstructionName::IMUL:
+            zero(i.constant.aux, 1);
+            transfer(i.constant.aux, i.constant.dst, 1);
+            transfer(i.constant.dst, i.constant.aux, 1, i.constant.value);
+            break;
+        case InstructionName::DIV:
+        case InstructionName::IDIV:
+        case InstructionName::MOD:
+        case InstructionName::IMOD:
+        case InstructionName::DIVMOD:
+        case InstructionName::IDIVMOD: {
+            bool isConstant = i.instr == InstructionName::IDIV || i.instr == InstructionName::IMOD
+                              || i.instr == InstructionName::IDIVMOD;
+            auto dst = isConstant ? i.constant.dst : i.copy.dst;
+            auto aux = isConstant ? i.constant.aux : i.copy.aux;
+            // aux holds 'n d r q 0 0': each unit of n moves to r, and when d reaches zero, r is moved back to d and q
+            // is incremented. The remainder is r and the quotient q, a divisor of zero acts like the cell size.
+            zero(aux, 6);
+            transfer(aux, dst, 1);
+            if (isConstant)
+                iadd(aux + 1, i.constant.value);
+            else
+                copy(aux + 1, i.copy.src, aux + 2, 1);
+            at(aux, "[->>+<-[>>>]>[[-<+>]>+>>]<<<<<]");
+            zero(aux + 1, 1);
+            if (i.instr == InstructionName::DIVMOD || i.instr == InstructionName::IDIVMOD) {
+                transfer(dst, aux + 3, 1);
+                zero(dst + 1, 1);
+                transfer(dst + 1, aux + 2, 1);
+                break;
+            }
+            bool quotient = i.instr == InstructionName::DIV || i.instr == InstructionName::IDIV;
+            transfer(dst, quotient ? aux + 3 : aux + 2, 1);
+            zero(quotient ? aux + 2 : aux + 3, 1);
+            break;
+        }
+        case InstructionName::LT:
+        case InstructionName::LE:
+        case InstructionName::GT:
+        case InstructionName::GE: {
+            // a < b: aux holds 'a 1 0 r' and b is counted down. Each step decrements a, or sets r if a already
+            // reached zero. a > b is b < a, a <= b is not b < a and a >= b is not a < b.
+            bool swap = i.instr == InstructionName::GT || i.instr == InstructionName::LE;
+            bool negate = i.instr == InstructionName::LE || i.instr == InstructionName::GE;
+            auto a = swap ? i.copy.src : i.copy.dst;
+            auto b = swap ? i.copy.dst : i.copy.src;
+            auto aux = i.copy.aux;
+            if (i.copy.size > 1) {
+                // a number of several cells is smaller, if subtracting b borrows from beyond the highest cell of a
+                carry(a, b, i.copy.size, aux, -1, true);
+                zero(a, i.copy.size);
+                if (negate)
+                    inc(i.copy.dst);
+                transfer(i.copy.dst, aux + 3, 1, negate ? -1 : 1);
+                break;
+            }
+            zero(aux, 4);
+            transfer(aux, a, 1);
+            inc(aux + 1);
+            if (negate)
+                inc(aux + 3);
+            loop(b, {aux, aux + 1, aux + 2, aux + 3}, [&] {
+                dec(b);
+                at(aux, negate ? "[->-]>[>>[-]<<->]<+<" : "[->-]>[>>[-]+<<->]<+<");
+            });
+            // both operands are zero now
+            zero(aux, 2);
+            transfer(i.copy.dst, aux + 3, 1);
+            break;
+        }
+        case InstructionName::EQ:
+        case InstructionName::NE: {
+            // the numbers are equal, if the difference of each cell is zero
+            auto aux = i.copy.aux;
+            transfer(i.copy.dst, i.copy.src, i.copy.size, -1);
+            zero(aux, 1);
+            for (int c = 0; c < i.copy.size; c++) {
+                loop(i.copy.dst + c, {aux}, [&] {
+                    zero(i.copy.dst + c, 1);
+                    zero(aux, 1);
+                    inc(aux);
+                });
+            }
+            if (i.instr == InstructionName::EQ)
+                inc(i.copy.dst);
+            transfer(i.copy.dst, aux, 1, i.instr == InstructionName::EQ ? -1 : 1);
+            break;
+        }
         case InstructionName::COMPARE:
-            if (!i.release || debug)
-                osprint(os, i.line, instruction_name_map.at(i.instr), i.comment);
-            if (i.release) {
-                if (debug) os << endl;
-                zero(os, i.compare.isZero, 1);
-                inc(os, i.compare.isZero);
-                zero(os, i.compare.notZero, 1);
-                insertAt(os, i.compare.conditionAddress, "[[-]");
-                inc(os, i.compare.notZero);
-                dec(os, i.compare.isZero);
-                insertAt(os, i.compare.conditionAddress, "]");
+            zero(i.compare.isZero, 1);
+            inc(i.compare.isZero);
+            zero(i.compare.notZero, 1);
+            for (int c = 0; c < i.compare.size; c++) {
+                auto condition = i.compare.conditionAddress + c;
+                loop(condition, {i.compare.isZero, i.compare.notZero}, [&] {
+                    zero(condition, 1);
+                    if (i.compare.size == 1) {
+                        inc(i.compare.notZero);
+                        dec(i.compare.isZero);
+                    } else {
+                        // more than one cell may be set
+                        zero(i.compare.isZero, 1);
+                        zero(i.compare.notZero, 1);
+                        inc(i.compare.notZero);
+                    }
+                });
             }
-            return os;
+            break;
         case InstructionName::PUSH_STACK:
+            // the pointer stays, but the stack base moves
+            rebase(i.stack.offset);
+            break;
         case InstructionName::POP_STACK:
-            if (!i.release || debug)
-                osprint(os, i.line, instruction_name_map.at(i.instr), i.stack.offset, i.comment);
-            if (i.release) {
-                if (debug) os << endl;
-                if (i.instr == InstructionName::POP_STACK)
-                    movePtr(os, -i.stack.offset);
-                else
-                    movePtr(os, i.stack.offset);
+            rebase(-i.stack.offset);
+            break;
+        case InstructionName::ARRAY_READ:
+        case InstructionName::ARRAY_WRITE: {
+            // the elements are 'm v d': a marker m, cells v to carry a value and the value d. The index is counted down
+            // while it is carried from marker to marker, and the passed markers are set to 1. The way back follows them
+            // to the marker in front of the first element, which is always 0.
+            auto size = i.array.size, stride = 2 * size + 1;
+            auto first = i.array.array + stride;
+            std::string forward = "[-" + shift(0, stride) + "+";
+            transfer(first, i.array.index, 1);
+            if (i.instr == InstructionName::ARRAY_WRITE) {
+                // the value is carried along and replaces the element
+                transfer(first + 1, i.array.value, size);
+                std::string store;
+                for (int c = 0; c < size; c++) {
+                    forward += shift(1 + c, 1 + c + stride);
+                    store += step(1 + size + c) + "[-]" + step(-1 - size - c) + shift(1 + c, 1 + size + c);
+                }
+                forward += step(stride) + "]";
+                walk(first, i.array.array, forward + store + step(-stride) + "[-" + step(-stride) + "]");
+            } else {
+                // the element is copied into v with the marker as auxiliary cell, and v is carried back
+                std::string load, carry;
+                for (int c = 0; c < size; c++) {
+                    load += step(1 + size + c) + "[-" + step(-size) + "+" + step(-1 - c) + "+" + step(1 + size + c) + "]"
+                            + step(-1 - size - c) + shift(0, 1 + size + c);
+                    carry += shift(1 + c, 1 + c - stride);
+                }
+                forward += step(stride) + "]";
+                walk(first, i.array.array, forward + load + carry + step(-stride) + "[-" + carry + step(-stride) + "]");
+                zero(i.array.value, size);
+                transfer(i.array.value, i.array.array + 1, size);
             }
-            return os;
+            break;
+        }
         case InstructionName::WRITE_INPUT:
         case InstructionName::WRITE_OUTPUT:
-            if (!i.release || debug)
-                osprint(os, i.line, instruction_name_map.at(i.instr), i.comment);
-            if (i.release) {
-                if (debug) os << endl;
-                foreach(os, i.io.src, i.io.size, i.instr == InstructionName::WRITE_INPUT ? "," : ".");
-            }
-            return os;
+            foreach(i.io.src, i.io.size, i.instr == InstructionName::WRITE_INPUT ? "," : ".");
+            break;
+        case InstructionName::WRITE_DECIMAL_INPUT: {
+            // aux holds 'f c a 1 0 r b e m': characters c are read while the flag f is set. c - '0' < 10 is computed
+            // like LT in a, then either n = n * 10 + c - '0', or the flag is cleared by the else flag e. Only a may
+            // wrap around, so loops run on c and a is cleared with it.
+            auto n = i.io.src, f = i.io.aux, c = f + 1, a = f + 2, r = f + 5, b = f + 6, e = f + 7, m = f + 8;
+            zero(n, 1);
+            zero(i.io.aux, i.io.size_aux);
+            inc(f);
+            loop(f, {n, c, a, a + 1, a + 2, r, b, e, m}, [&] {
+                at(c, ",");
+                copy(a, c, e, 1);
+                iadd(a, -'0');
+                inc(a + 1);
+                iadd(b, 10);
+                loop(b, {a, a + 1, a + 2, r}, [&] {
+                    dec(b);
+                    at(a, "[->-]>[>>[-]+<<->]<+<");
+                });
+                zero(a + 1, 1);
+                inc(e);
+                loop(r, {n, c, e, m}, [&] {
+                    dec(r);
+                    dec(e);
+                    transfer(m, n, 1);
+                    transfer(n, m, 1, 10);
+                    transfer(n, c, 1);
+                    iadd(n, -'0');
+                });
+                loop(e, {c, a, f}, [&] {
+                    dec(e);
+                    // a is c - '0' - 10
+                    iadd(a, '0' + 10);
+                    transfer(a, c, 1, -1);
+                    dec(f);
+                });
+            });
+            break;
+        }
+        case InstructionName::WRITE_DECIMAL_OUTPUT: {
+            // Behind a zero marker, each step divides the number by 10 and leaves the remainder + 1 in place of
+            // the number and the quotient in the next cell, until the quotient is zero. The digits are then printed
+            // from the highest one back to the marker.
+            std::string digit = ">++++++++++<[->>+<-[>>>]>[[-<+>]>+>>]<<<<<]>[-]>[-<<+>>]<<+>>>[-<<+>>]<<";
+            zero(i.io.aux, i.io.size_aux);
+            copy(i.io.aux + 1, i.io.src, i.io.aux + 2, 1);
+            at(i.io.aux + 1, digit + "[" + digit + "]<[>+++++++[<+++++++>-]<--.[-]<]>");
+            break;
+        }
         case InstructionName::TEST:
-            if (!i.release || debug)
-                osprint(os, i.line, instruction_name_map.at(i.instr), i.comment);
-            if (i.release) {
-                if (debug) os << endl;
-                zero(os, i.test.jumpRegister, 1);
-
-                insertAt(os, i.test.isTrue, "[[-]");
-                zero(os, i.test.jumpRegister, 1);
-                iadd(os, i.test.jumpRegister, i.test.trueLabel, 1);
-                insertAt(os, i.test.isTrue, "]");
-
-                insertAt(os, i.test.isFalse, "[[-]");
-                zero(os, i.test.jumpRegister, 1);
-                iadd(os, i.test.jumpRegister, i.test.falseLabel, 1);
-                insertAt(os, i.test.isFalse, "]");
-                osprint(os<<endl, string(static_cast<unsigned long>(i.test.jumpRegister), '>'));
-                osprint(os, ">[-]>[-]+<<>]<>]>[[-]<+>]<");
-            }
-            return os;
+            zero(i.test.jumpRegister, 1);
+
+            // the cell after the registers is free once the condition was compared
+            at(i.test.isTrue, "[");
+            zero(i.test.isTrue, 1);
+            zero(i.test.jumpRegister, 1);
+            iadd(i.test.jumpRegister, i.test.trueLabel, i.test.jumpRegister + 3);
+            at(i.test.isTrue, "]");
+
+            at(i.test.isFalse, "[");
+            zero(i.test.isFalse, 1);
+            zero(i.test.jumpRegister, 1);
+            iadd(i.test.jumpRegister, i.test.falseLabel, i.test.jumpRegister + 3);
+            at(i.test.isFalse, "]");
+            dispatch(i.test.jumpRegister, ">[-]>[-]+<<>]<>]>[[-]<+>]<");
+            break;
+        case InstructionName::BEGIN_IF:
+            // the condition is 1, so a single '-' clears it and the loop ends after one pass
+            at(i.branch.condition, "[-");
+            known[i.branch.condition] = 0;
+            break;
+        case InstructionName::END_IF:
+            at(i.branch.condition, "]");
+            break;
         case InstructionName::CALL:
-            if (!i.release || debug)
-                osprint(os, i.line, instruction_name_map.at(i.instr), i.comment);
-            if (i.release) {
-                if (debug) os << endl;
-                zero(os, i.call.returnCell, 1);
-                iadd(os, i.call.returnCell, i.call.returnAddress, 1);
-            }
-            return os;
+            zero(i.call.returnCell, 1);
+            iadd(i.call.returnCell, i.call.returnAddress, i.call.aux);
+            break;
         case InstructionName::RET:
-            if (!i.release || debug)
-                osprint(os, i.line, instruction_name_map.at(i.instr), i.comment);
-            if (i.release) {
-                if (debug) os << endl;
-                // todo: replace ">[-]>[-]+<<[-]" with ">[-]>-*self_address+<<[-]" maybe
-                osprint(os, string(static_cast<unsigned long>(i.ret.ret), '>') + ">[-]>[-]" + (i.ret.exit ? "":"+") + "<<>]<>]>[[-]<+>]<");
-            }
-            return os;
+            // todo: replace ">[-]>[-]+<<[-]" with ">[-]>-*self_address+<<[-]" maybe
+            dispatch(i.ret.ret, std::string(">[-]>[-]") + (i.ret.exit ? "" : "+") + "<<>]<>]>[[-]<+>]<");
+            break;
         case InstructionName::LABEL:
-            if (!i.release || debug)
-                osprint(os << endl, i.line, instruction_name_map.at(i.instr), i.comment);
-            if (i.release) {
-                if (debug) os << endl;
-                osprint(os, "[[-]>[-]<<[->+>+<<]>[-<+>]+<>>" + string(i.label.address, '-') + "[[-]<->]<<>>+<<>[<");
-                /**
-                    +   main function is target
-                    >+  marker at target+1
-                    [   enter program
-
-                    [[-]>[-]<<                          clear target+1 and target + 2
-                    [->+>+<<]>[-<+>]+<                  copy target to target+2 and set target+1 to 1
-                    >>fun_adr[[-]<->]<<                 subtract own address from target+2 and set target+1 to 0 if target+2 is not equal to fun_adr
-                    >>+<<                               set target+2 to 1
-                    >[<                                 if target+1 is 1, execute custom code
-                                                        custom code; finishes on new 'target' cell with desired new address
-                    >[-]>[-]continue(1|0)<<[-]target    clear target+1; set target+2 to 1 for continue or 0 to exit; set next jump at target to desired address
-                    >]<
-                    >]                                  exit at target+1
-
-                    >[[-]<+>]<                          set target+1 to 1 if target+2 is not 0;
-
-                    ]                                   exit program
-                 */
-            }
-            return os;
+            // the jump register holds the address, so it must fit into a cell
+            if (i.label.address >= state.cellRange())
+                die(i.file, i.line, EXIT_FAILURE, "Too many labels for cells of", state.cellBits, "bits, use a larger --cell-bits");
+            // every block is entered with the pointer on the cell after the jump register
+            assert(pending.empty());
+            // a wide cell below the address would be cleared through the whole range, so the address is added back
+            // and only the jump target is cleared
+            os << "[[-]>[-]<<[->+>+<<]>[-<+>]+<>>" + string(i.label.address, '-') + "["
+                  + (state.cellBits > 8 ? string(i.label.address, '+') : "") + "[-]<->]<<>>+<<>[<";
+            position = 0;
+            // the registers hold the matched address and two set flags
+            known.clear();
+            known[0] = wrap(i.label.address);
+            known[1] = 1;
+            known[2] = 1;
+            /**
+                +   main function is target
+                >+  marker at target+1
+                [   enter program
+
+                [[-]>[-]<<                          clear target+1 and target + 2
+                [->+>+<<]>[-<+>]+<                  copy target to target+2 and set target+1 to 1
+                >>fun_adr[[-]<->]<<                 subtract own address from target+2 and set target+1 to 0 if target+2 is not equal to fun_adr
+                >>+<<                               set target+2 to 1
+                >[<                                 if target+1 is 1, execute custom code
+                                                    custom code; finishes on new 'target' cell with desired new address
+                >[-]>[-]continue(1|0)<<[-]target    clear target+1; set target+2 to 1 for continue or 0 to exit; set next jump at target to desired address
+                >]<
+                >]                                  exit at target+1
+
+                >[[-]<+>]<                          set target+1 to 1 if target+2 is not 0;
+
+                ]                                   exit program
+             */
+            break;
         case InstructionName::WRITE_INLINE:
-            if (!i.release || debug)
-                osprint(os, i.line, instruction_name_map.at(i.instr), i.inline_code.inlineStr);
-            if (i.release)
-                osprint(os, i.inline_code.inlineStr);
-            return os;
+            // inline code starts and ends at the stack base
+            dispatch(0, i.inlineStr);
+            break;
         case InstructionName::JUMP:
-            if (!i.release || debug)
-                osprint(os, i.line, instruction_name_map.at(i.instr), i.comment);
-            if (i.release) {
-                if (debug) os << endl;
-                // todo: replace ">[-]>[-]+<<[-]" with ">[-]>-*self_address+<<[-]" maybe
-                osprint(os, ">[-]>[-]+<<[-]" + string(i.jump.targetAddress, '+') + ">]<>]>[[-]<+>]<");
-            }
-            return os;
+            // todo: replace ">[-]>[-]+<<[-]" with ">[-]>-*self_address+<<[-]" maybe
+            zero(0, 3);
+            inc(2);
+            // the dispatcher only uses the first three cells
+            iadd(0, i.jump.targetAddress, 3);
+            dispatch(0, ">]<>]>[[-]<+>]<");
+            break;
         case InstructionName::EXIT:
-            if (!i.release || debug)
-                osprint(os, i.line, instruction_name_map.at(i.instr), i.comment);
-            if (i.release)
-                osprint(os, "[-]" + string((unsigned long) i.exit.exitCode, '+') + "@");
+            dispatch(0, "[-]" + string((unsigned long) i.exit.exitCode, '+') + "@");
             // todo: exit keyword
-            return os;
+            break;
         case InstructionName::UNINITIALIZED:
             die(i.file, i.line, EXIT_FAILURE, "Uninitialized instruction");
     }
-    return os;
+}
+
+label CompilationState::newJumpAddress() {
+    return ++jumpAddressCounter;
+}
+
+void CompilationState::reserveJumpAddresses(label count) {
+    jumpAddressCounter += count;
+}
+
+void emitIntermediate(std::ostream &os, const CompilationState &state) {
+    for (auto fun : state.functions)
+        for (auto &i : fun->code)
+            osprintln(os, i);
+}
+
+void emitBinary(std::ostream &os, const CompilationState &state) {
+    // the functions don't depend on each other, the threads take the next function and write it into its own buffer
+    vector<std::string> code(state.functions.size());
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (size_t f = next++; f < code.size(); f = next++) {
+            std::stringstream ss;
+            Emitter emitter(ss, state);
+            for (auto &i : state.functions[f]->code) {
+                if (debug)
+                    osprintln(ss, i);
+                emitter.emit(i);
+                if (debug) {
+                    emitter.flush(emitter.position);
+                    ss << endl;
+                }
+            }
+            emitter.flush(0);
+            code[f] = ss.str();
+        }
+    };
+    vector<std::thread> threads;
+    for (size_t t = 1; t < std::min<size_t>(state.jobs, code.size()); t++)
+        threads.emplace_back(worker);
+    worker();
+    for (auto &thread : threads)
+        thread.join();
+
+    // the buffers are written in the order of the functions, so the binary doesn't depend on the number of threads
+    for (auto &function : code)
+        os << function;
+}
+
+cellValue CompilationState::cellRange() const {
+    return (cellValue) 1 << cellBits;
+}
+
+cellValue CompilationState::wrap(cellValue value) const {
+    return ((value % cellRange()) + cellRange()) % cellRange();
 }
 
 CompilationState::CompilationState() : main(nullptr) {
-    // Initialize SymbolTable with the native type of "cell"
-    struct CellSymbol : TypeSymbol {
-        size_t getSizeSumOfChildSymbols() const override { return 1; }
-        CellSymbol() : TypeSymbol(0, "<init>", "cell") {}
+    // Initialize SymbolTable with the native types "cell", "u16" and "u32"
+    struct NumberSymbol : TypeSymbol {
+        const CompilationState &state;
+        // bits of the number, or 0 for a single cell
+        int bits;
+        size_t getSizeSumOfChildSymbols() const override { return (size_t) std::max(1, bits / state.cellBits); }
+        NumberSymbol(const CompilationState &state, string name, int bits) : TypeSymbol(0, "<init>", name), state(state), bits(bits) {}
     };
-    cellType = new CellSymbol();
+    cellType = symbolTable.create<NumberSymbol>(*this, "cell", 0);
     symbolTable.add(*cellType);
+    u16Type = symbolTable.create<NumberSymbol>(*this, "u16", 16);
+    symbolTable.add(*u16Type);
+    u32Type = symbolTable.create<NumberSymbol>(*this, "u32", 32);
+    symbolTable.add(*u32Type);
 }
 
 void ExpressionStatement::compile(CompilationState &state) {
@@ -1532,8 +3519,11 @@ VariableStatement::~VariableStatement() {
 }
 
 void VariableStatement::compile(CompilationState &state) {
-    for (auto var : *variables)
+    for (auto var : *variables) {
         var->compile(state);
+        auto address = (int) state.symbolTable.findGlobal(QualifiedName{*var->name}).dereference(state.currentFile, line);
+        outputArrayClearInstruction(state.currentFile, line, state, var->variableSymbol, address);
+    }
 }
 
 VariableStatement::VariableStatement(vector<VariableDefinition *> *variables) : variables(variables) { }
@@ -1550,7 +3540,9 @@ Expression::Expression() : out(nullptr), dst(nullptr) {}
 
 Expression::~Expression() {}
 
-ASTNode::ASTNode() : line(yylineno), column(columnno), len(yyleng), file(currentFile) {}
+thread_local CompilationState *ASTNode::parsing = nullptr;
+
+ASTNode::ASTNode() : line(parsing->line), column(parsing->column), len(parsing->tokenLength) {}
 
 ASTNode::~ASTNode() {}
 
@@ -1574,5 +3566,6 @@ StringExpression::~StringExpression() {
 void StringExpression::compile(CompilationState &state) {
     std::string parsed = parseStringEscape(*string);
     out = state.symbolTable.newTmpVariable(line, state.cellType, static_cast<int>(parsed.size()));
-    outputLoadStringInstruction(file, line, out, parsed);
+    auto aux = (int) state.symbolTable.currentScope()->getCurrentAddressOfFunctionStackframeEnd();
+    outputLoadStringInstruction(state.currentFile, line, state, out, parsed, aux);
 }
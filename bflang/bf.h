@@ -9,7 +9,10 @@
 #include <fstream>
 #include <sstream>
 #include <map>
+#include <unordered_map>
+#include <functional>
 #include <array>
+#include "arena.h"
 #include "print.h"
 
 struct SymbolTable;
@@ -24,6 +27,7 @@ struct ReturnVariableDefinition;
 struct VariableType;
 struct FunctionStatement;
 struct ListStatement;
+struct CompilationState;
 
 // Path needed to qualify a symbol reference
 typedef std::vector<std::string> QualifiedName;
@@ -34,20 +38,16 @@ typedef int cellSize;
 // An address, that is executable
 typedef int label;
 // Constant values like offset or integers
-typedef int cellValue;
-
-extern FILE *yyin;
-extern int columnno;
-extern int yylineno;
-extern size_t yyleng;
-extern int yylex(void);
-extern void yyerror(const char *s);
-extern int yyparse();
-extern ListStatement *bisonAST;
-extern void yyrestart(FILE*);
-extern std::string currentFile;
-extern std::ofstream binary_output_stream;
-extern std::ofstream intermediate_output_stream;
+typedef long long cellValue;
+
+// state of the reentrant scanner, which keeps the compilation as its extra data
+typedef void *yyscan_t;
+extern int yylex_init_extra(CompilationState *state, yyscan_t *scanner);
+extern void yyset_in(FILE *input, yyscan_t scanner);
+extern int yylex_destroy(yyscan_t scanner);
+extern int yyparse(CompilationState &state, yyscan_t scanner);
+// parses 'input' into the tree of a file, or returns nullptr
+ListStatement *parse(CompilationState &state, FILE *input);
 extern bool verbose;
 extern bool verboseSymbolTable;
 extern bool debug;
@@ -76,21 +76,63 @@ enum class InstructionName {
     ILOAD,
     // moves 'size' bytes from src to dst
     MOVE,
+    // sets isZero to 1 and notZero to 0, if all 'size' bytes at the condition are zero, and the other way around
     COMPARE,
     // copies 'size' bytes from src to dst, using 'size_aux' auxilliary bytes at aux
     COPY,
     // adds 'size' bytes from src to dst
     ADD,
-    // adds 'const' to all 'size' bytes at 'dst'
+    // adds 'const' to all 'size' bytes at 'dst', using the two cells at 'aux' if that gives shorter code
     IADD,
     // adds 'size' bytes from src to dst, using 'size_aux' auxilliary bytes at aux
     ADD_COPY,
+    // adds the number of 'size' bytes at src to the one at dst, lowest byte first, with a carry between the bytes.
+    // src is cleared and 5 auxilliary bytes at aux are used
+    ADD_CARRY,
     // subs 'size' bytes from src to dst
     SUB,
     // subs 'const' to all 'size' bytes at 'dst'
     ISUB,
     // subs 'size' bytes from src to dst, using 'size_aux' auxilliary bytes at aux
     SUB_COPY,
+    // subs the number of 'size' bytes at src from the one at dst with a borrow between the bytes, like ADD_CARRY
+    SUB_CARRY,
+    // adds 'const' to the number of 'size' bytes at dst with a carry between the bytes, using 6 auxilliary bytes at aux
+    IADD_CARRY,
+    // multiplies dst with src, using 2 auxilliary bytes at aux
+    MUL,
+    // multiplies dst with 'const', using the auxilliary byte at aux
+    IMUL,
+    // divides dst by src, using 6 auxilliary bytes at aux
+    DIV,
+    // divides dst by 'const', using 6 auxilliary bytes at aux
+    IDIV,
+    // sets dst to the remainder of the division by src, using 6 auxilliary bytes at aux
+    MOD,
+    // sets dst to the remainder of the division by 'const', using 6 auxilliary bytes at aux
+    IMOD,
+    // divides dst by src, leaving the quotient in dst and the remainder in dst+1, using 6 auxilliary bytes at aux
+    DIVMOD,
+    // divides dst by 'const' like DIVMOD
+    IDIVMOD,
+    // sets dst to 1 if dst is smaller than src and to 0 otherwise, clears src and uses 4 auxilliary bytes at aux.
+    // Numbers of more than one byte leave the result in the first byte of dst and use 5 auxilliary bytes
+    LT,
+    // sets dst to 1 if dst is smaller than or equal to src, like LT
+    LE,
+    // sets dst to 1 if dst is greater than src, like LT
+    GT,
+    // sets dst to 1 if dst is greater than or equal to src, like LT
+    GE,
+    // sets dst to 1 if dst is equal to src, clears src and uses the auxilliary byte at aux
+    EQ,
+    // sets dst to 1 if dst is not equal to src, like EQ
+    NE,
+    // copies the element of 'size' bytes at the index in 'index' of the array at 'array' into 'value'. The index is
+    // cleared and the pointer walks to the element on the cells between the elements
+    ARRAY_READ,
+    // moves the 'size' bytes at 'value' into the element at the index in 'index' of the array at 'array', like ARRAY_READ
+    ARRAY_WRITE,
     // moves the pointer to the current top of the stack at offset 'offset'
     PUSH_STACK,
     // moves the pointer 'offset' bytes from the top of the stack
@@ -99,8 +141,17 @@ enum class InstructionName {
     WRITE_INPUT,
     // outputs the 'size' bytes from src
     WRITE_OUTPUT,
+    // reads a decimal number into src, using 'size_aux' auxilliary bytes at aux
+    WRITE_DECIMAL_INPUT,
+    // outputs src as decimal number, using 'size_aux' auxilliary bytes at aux
+    WRITE_DECIMAL_OUTPUT,
     // if 'condition' is 0, write the value of 'true' in the jump register, and the value of 'false' if it is not
     TEST,
+    // runs the instructions up to the matching END_IF once, if the cell 'condition' is 1, and clears it. The
+    // instructions in between must not jump
+    BEGIN_IF,
+    // ends the instructions of the BEGIN_IF on the same 'condition'
+    END_IF,
     // writes the address of the target 'jump_target' into the jump register and the address of the return point into 'return_target'
     CALL,
     // signals end of function
@@ -124,14 +175,37 @@ const std::map<InstructionName, const char*> instruction_name_map {
         {InstructionName::ADD, "ADD"},
         {InstructionName::IADD, "IADD"},
         {InstructionName::ADD_COPY, "ADD_COPY"},
+        {InstructionName::ADD_CARRY, "ADD_CARRY"},
         {InstructionName::SUB, "SUB"},
         {InstructionName::ISUB, "ISUB"},
         {InstructionName::SUB_COPY, "SUB_COPY"},
+        {InstructionName::SUB_CARRY, "SUB_CARRY"},
+        {InstructionName::IADD_CARRY, "IADD_CARRY"},
+        {InstructionName::MUL, "MUL"},
+        {InstructionName::IMUL, "IMUL"},
+        {InstructionName::DIV, "DIV"},
+        {InstructionName::IDIV, "IDIV"},
+        {InstructionName::MOD, "MOD"},
+        {InstructionName::IMOD, "IMOD"},
+        {InstructionName::DIVMOD, "DIVMOD"},
+        {InstructionName::IDIVMOD, "IDIVMOD"},
+        {InstructionName::LT, "LT"},
+        {InstructionName::LE, "LE"},
+        {InstructionName::GT, "GT"},
+        {InstructionName::GE, "GE"},
+        {InstructionName::EQ, "EQ"},
+        {InstructionName::NE, "NE"},
+        {InstructionName::ARRAY_READ, "ARRAY_READ"},
+        {InstructionName::ARRAY_WRITE, "ARRAY_WRITE"},
         {InstructionName::PUSH_STACK, "PUSH_STACK"},
         {InstructionName::POP_STACK, "POP_STACK"},
         {InstructionName::WRITE_INPUT, "INPUT"},
         {InstructionName::WRITE_OUTPUT, "OUTPUT"},
+        {InstructionName::WRITE_DECIMAL_INPUT, "INPUT_DEC"},
+        {InstructionName::WRITE_DECIMAL_OUTPUT, "OUTPUT_DEC"},
         {InstructionName::TEST, "TEST"},
+        {InstructionName::BEGIN_IF, "IF"},
+        {InstructionName::END_IF, "END_IF"},
         {InstructionName::CALL, "CALL"},
         {InstructionName::RET, "RETURN"},
         {InstructionName::JUMP, "JUMP"},
@@ -144,7 +218,6 @@ struct Instruction {
     std::string file;
     int line;
     InstructionName instr;
-    bool release;
     union {
         struct {
             cellReference dst, src, aux;
@@ -158,6 +231,7 @@ struct Instruction {
 
         struct {
             cellReference conditionAddress;
+            cellSize size;
             label isZero, notZero;
         } compare;
 
@@ -165,6 +239,8 @@ struct Instruction {
             cellReference dst;
             cellSize size;
             cellValue value;
+            // first of two free cells, that may be used to generate the constant, or -1
+            cellReference aux;
         } constant;
 
         struct {
@@ -172,8 +248,18 @@ struct Instruction {
             cellReference src;
             // size of the cell
             cellSize size;
+            // free cells for the decimal conversion
+            cellReference aux;
+            cellSize size_aux;
         } io;
 
+        struct {
+            // first cell of the array, the cell with the index and the value to read or write
+            cellReference array, index, value;
+            // size of an element and number of cells of the whole array
+            cellSize size, length;
+        } array;
+
         struct {
             // offset of the new stack
             cellValue offset;
@@ -183,7 +269,9 @@ struct Instruction {
             // cell to where the adderss will be saved
             cellReference returnCell;
             // address to return to
-            cellValue returnAddress;
+            label returnAddress;
+            // free cell, that may be used to generate the address, or -1
+            cellReference aux;
         } call;
 
         struct {
@@ -195,17 +283,17 @@ struct Instruction {
             label targetAddress;
         } jump;
 
+        struct {
+            // cell, that decides whether the instructions run
+            cellReference condition;
+        } branch;
+
         struct {
             // Location of the cell, where the return address is stored (after the return values)
             cellReference ret;
             bool exit;
         } ret;
 
-        struct {
-            // String to be inlined
-            const char *inlineStr;
-        } inline_code;
-
         struct {
             // Jumpable address to the label
             label address;
@@ -217,16 +305,18 @@ struct Instruction {
         } exit;
     };
     std::string comment;
+    // String to be inlined by WRITE_INLINE
+    std::string inlineStr;
 
     Instruction(const std::string file, int line, InstructionName instr = InstructionName::UNINITIALIZED, std::string comment = "")
-            : file(file), line(line), instr(instr), comment(comment), release(false) {}
+            : file(file), line(line), instr(instr), comment(comment) {}
     friend std::ostream &operator<<(std::ostream &os, const Instruction &i);
 };
 
 struct Symbol {
     bool temp = false;
-    // todo: use not accessed but allocated temporaries if possible
-    bool used = false;
+    // temporary, whose value is not needed anymore; newTmpVariable may reuse its cells
+    bool released = false;
 	// todo: inaccessable temporary/hidden symbols
 	bool hidden = false;
 
@@ -238,19 +328,22 @@ struct Symbol {
 	Symbol(int line, string file, string name)
 		: line(line), file(file), name(name), parent(nullptr) {};
 
-	virtual ~Symbol() {
-        for (Symbol *s : symbols)
-            delete s;
-        parent = nullptr;
-    };
+    // symbols are owned by the SymbolTable, that created them, not by their parent
+	virtual ~Symbol() {}
 
-    // gets the concatenated symbol names up until the root
-    QualifiedName getQualified() const;
+    // gets the concatenated symbol names up until the root, computed once the symbol has a parent
+    const QualifiedName &getQualified() const;
 
     // Set parent member and adds this symbol as a child to the parent
     // returns nullptr if a parent was already set, else returns this
     void setParent(Symbol *newParent);
 
+    // the child with the name, or nullptr
+    Symbol *findChild(const string &childName) const;
+
+    // removes a child from 'symbols'
+    void removeChild(vector<Symbol*>::iterator child);
+
     // place that contains inner symbols
 	virtual Symbol *getScope() { return this; };
 
@@ -262,23 +355,42 @@ struct Symbol {
     virtual size_t getSizeOnTheStack() const { return 0; };
     virtual size_t getAddressRelativeToParent() const { return 0; };
     virtual size_t getAddressRelativeToFunctionStackframe() const { return 0; };
+    // size of the child symbols up to the last one that is still alive
+    size_t getLiveSizeOfChildSymbols() const;
     // gives the address after this symbol
     size_t getCurrentAddressOfFunctionStackframeEnd() const { return getSizeSumOfChildSymbols() + getAddressRelativeToFunctionStackframe(); }
     // returns the next function in the hierarchy
     const FunctionSymbol *getParentFunctionStackframe() const;
+
+private:
+    // cached result of getQualified, most symbols never need it
+    mutable unique_ptr<QualifiedName> qualified;
+    // children by name, built once there are enough children, that scanning them gets slow. The keys refer to the
+    // names of the children, which don't change
+    typedef unordered_map<reference_wrapper<const string>, Symbol*, hash<string>, equal_to<string>> ChildIndex;
+    unique_ptr<ChildIndex> index;
 };
 
 struct SymbolResolutionResult {
     Symbol *resolved;
     Symbol *scope;
     vector<const Symbol*> resolutionPath;
+    // the variable is not read afterwards and may be moved instead of copied
+    bool lastUse = false;
+    // cells from the resolved variable to an element of an array at a constant index
+    size_t offset = 0;
+    // size of that element, or -1 if the whole variable is resolved
+    int elementSize = -1;
 
     explicit SymbolResolutionResult(Symbol *scope)
             : resolved(nullptr), scope(scope) {}
 
     size_t dereference(const string &file, int line) const;
 
-    SymbolResolutionResult &find(string name);
+    // number of cells of the resolved variable or element
+    size_t size() const;
+
+    SymbolResolutionResult &find(const string &name);
 
     QualifiedName qualified() const;
 
@@ -287,7 +399,9 @@ struct SymbolResolutionResult {
     std::string name() const;
 
     operator bool() const { return resolved != nullptr; }
-    bool operator==(const SymbolResolutionResult &that) const { return *this && that && resolved == that.resolved; }
+    bool operator==(const SymbolResolutionResult &that) const {
+        return *this && that && resolved == that.resolved && offset == that.offset && elementSize == that.elementSize;
+    }
     bool operator!=(const SymbolResolutionResult &that) const { return !(*this == that); }
 };
 
@@ -297,7 +411,16 @@ struct SymbolTable {
 	SymbolTable();
     ~SymbolTable() {
         assert(scopeStack.size() == 1);
-        delete scopeStack[0];
+        for (auto s = created.rbegin(); s != created.rend(); s++)
+            (*s)->~Symbol();
+    }
+
+    // creates a symbol in the arena of the table; all symbols are freed together with the table
+    template<typename T, typename... Args>
+    T *create(Args &&... args) {
+        auto symbol = new (arena.allocate(sizeof(T))) T(std::forward<Args>(args)...);
+        created.push_back(symbol);
+        return symbol;
     }
 
 	// gets the top of the scope stack
@@ -312,30 +435,95 @@ struct SymbolTable {
 	// reverses push
 	void pop();
 
-    // todo: implement symbol removal for temporaries maybe?
-    void remove(Symbol &symbol);
+    // marks a consumed temporary as dead, and shrinks the current scope if possible
+    void release(const SymbolResolutionResult &result);
+
+    // removes released temporaries from the end of a scope
+    void trim(Symbol *scope);
+
+    // memory and list of all symbols of the table, including released temporaries removed from their scope
+    Arena arena;
+    vector<Symbol*> created;
+
+    // numbers the names of temporaries and stackframes
+    int tmpCount = 0, frameCount = 0;
+
+    // released temporaries are reused and overwritten by later stackframes, --disable-pass name reuse-temporaries
+    bool reuseTemporaries = true;
 
     // creates a stackframe for a function call
     void initFunctionStackframe(const std::string &file, int line, bool temporary);
 
     // searches a symbol in the current scope and it's parents
-	SymbolResolutionResult findGlobal(QualifiedName qualified);
+	SymbolResolutionResult findGlobal(const QualifiedName &qualified);
 
     // todo: table of jumpable locations / location manager
 
     // todo: offsets in variables (for arrays and input/output)
 
-    SymbolResolutionResult newTmpVariable(int line, TypeSymbol *type, int length = -1, const char *debug_prefix = "__tmp");
+    // creates a temporary in the current scope, that may reuse the cells of a released temporary
+    SymbolResolutionResult newTmpVariable(int line, TypeSymbol *type, int length = -1, const char *debug_prefix = "__tmp", bool reuse = true);
     StackframeSymbol *newTmpStackframe(int line);
 };
 
 struct CompilationState {
     SymbolTable symbolTable;
     TypeSymbol *cellType;
+    // built-in numbers of 16 and 32 bits in as many cells as needed, lowest cell first
+    TypeSymbol *u16Type, *u32Type;
     FunctionSymbol *main;
+    // all compiled functions in order of definition
+    vector<FunctionSymbol*> functions;
+    // the last reserved jumpable address
+    label jumpAddressCounter = 0;
+    // the input file, that is currently compiled
+    string currentFile;
+    // width of a cell in the target, 8, 16 or 32
+    int cellBits = 8;
+    // number of threads, that write the code of the functions
+    unsigned jobs = 1;
+    // instructions of the function, that is currently compiled
+    vector<Instruction> *currentCode = nullptr;
+    // false after a jump, until the next label
+    bool reachable = true;
+    // optimizations of the code generation, named like the passes for --disable-pass and off at -O0
+    // moves variables at their last use and lets a call return directly into its destination: last-use
+    bool moveLastUse = true;
+    // reuses the frame of the calling function for calls in tail position: tail-calls
+    bool tailCalls = true;
+    // sums nested constants and adds constants in the destination: fold-constants
+    bool foldConstants = true;
+    // moves read-only arguments into the callee and back instead of copying them: lend-arguments
+    bool lendArguments = true;
+    // the tree of the file, that is parsed, and the position and length of its last token
+    ListStatement *ast = nullptr;
+    // memory of the nodes of the file, that is currently compiled
+    Arena nodes;
+    int line = 1, column = 0;
+    size_t tokenLength = 0;
+    // text of the string literal, that is scanned
+    string literal;
     CompilationState();
+
+    // number of values a cell can hold
+    cellValue cellRange() const;
+
+    // the value of a cell, that 'value' wraps around to
+    cellValue wrap(cellValue value) const;
+
+    // reserves a new jumpable address
+    label newJumpAddress();
+
+    // reserves the next 'count' jumpable addresses
+    void reserveJumpAddresses(label count);
 };
 
+// writes the intermediate representation of all functions
+void emitIntermediate(std::ostream &os, const CompilationState &state);
+
+// writes the brainfuck code of all functions, without the program entry and exit
+void emitBinary(std::ostream &os, const CompilationState &state);
+
 struct TypeSymbol : Symbol {
     TypeSymbol(int line, string file, string name) : Symbol(line, file, name) {}
 
@@ -347,13 +535,25 @@ struct VariableSymbol : Symbol {
     TypeSymbol *type;
 	int length = 1;
 	bool isPointerType = false;
+	// declared as 'type*length' and indexable at runtime, see getElementStride
+	bool isArray = false;
+    // cached result of getAddressRelativeToParent, or -1
+    mutable size_t addressInParent = size_t(-1);
 
     VariableSymbol(int line, string file, string name, TypeSymbol *type);
 
+    // cells from one element of an array to the next: a marker cell, cells to carry a value and the value. The first
+    // stride holds no element, but the cells the walks to the elements end on
+    size_t getElementStride() const;
+
+    // address of the value of element 'index' relative to the array
+    size_t getElementAddress(cellValue index) const;
+
     size_t getSizeSumOfChildSymbols() const override;
 
     size_t getSizeOnTheStack() const override;
 
+    // the symbols before a variable don't change their size, so its address is computed once
     size_t getAddressRelativeToParent() const override;
 
     size_t getAddressRelativeToFunctionStackframe() const override;
@@ -368,6 +568,12 @@ struct FunctionSymbol : Symbol {
     Symbol *memberOf = nullptr;
     vector<SymbolResolutionResult> parameters;
     vector<SymbolResolutionResult> returnValues;
+    // whether the body leaves each parameter unchanged, so the caller can lend its variable instead of a copy
+    vector<bool> readOnly;
+    // compiled instructions of the function body, emitted after all passes ran
+    vector<Instruction> code;
+    // calls are replaced by the body, if optimizations are enabled
+    bool isInline = false;
 
     FunctionSymbol(int line, string file, string name, int address);
 
@@ -375,6 +581,8 @@ struct FunctionSymbol : Symbol {
 };
 
 struct StackframeSymbol : Symbol {
+    // address in the parent, fixed when the frame is created
+    size_t offset = 0;
 
     size_t getSizeSumOfChildSymbols() const override;
 
@@ -389,9 +597,15 @@ struct ASTNode {
 	int line;
     int column;
     size_t len;
-    string file;
 	ASTNode();
 	virtual ~ASTNode();
+
+    // compilation, whose file is parsed on this thread, which gives the nodes their position and memory
+    static thread_local CompilationState *parsing;
+
+    // nodes are placed into the arena of their compilation, which is freed after their file was compiled
+    static void *operator new(size_t size) { return parsing->nodes.allocate(size); }
+    static void operator delete(void *) {}
     virtual void compile(CompilationState &state) {}
 };
 
@@ -406,14 +620,16 @@ struct Expression : ASTNode {
 };
 
 struct IntExpression : Expression {
-	int integer;
-    IntExpression(int integer) : integer(integer) {}
+	cellValue integer;
+    IntExpression(cellValue integer) : integer(integer) {}
 
     void compile(CompilationState &state) override;
 };
 
 struct IdentifierExpression : Expression {
 	string *identifier;
+    // set by the last use analysis, if the variable is dead after this read
+    bool lastUse = false;
 
 	IdentifierExpression(string *identifier);
 
@@ -424,7 +640,8 @@ struct IdentifierExpression : Expression {
 
 struct BinaryOperatorExpression : Expression {
     enum OperatorType {
-        OP_MOV, OP_ADD, OP_SUB, OP_MUL, OP_DIV
+        OP_MOV, OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_MOD,
+        OP_EQ, OP_NE, OP_LT, OP_LE, OP_GT, OP_GE, OP_AND, OP_OR
     } op;
 	Expression *lhs, *rhs;
 	BinaryOperatorExpression(OperatorType op, Expression *lhs, Expression *rhs);
@@ -446,17 +663,39 @@ struct DotExpression : Expression {
     void compile(CompilationState &state) override;
 };
 
+struct IndexExpression : Expression {
+    Expression *array, *index;
+
+    IndexExpression(Expression *array, Expression *index);
+
+    ~IndexExpression() override;
+
+    // resolves elements at constant indices and reads the others into a temporary
+    void compile(CompilationState &state) override;
+
+    // moves 'value' into the element
+    void compileStore(CompilationState &state, const SymbolResolutionResult &value);
+
+    // the index is a constant, so the element is resolved like a variable
+    bool isConstant(const CompilationState &state) const;
+};
+
 struct CallExpression : Expression {
 	Expression *fun;
 	Expression *arguments;
     vector<SymbolResolutionResult> argumentsToPush;
     vector<SymbolResolutionResult> returnValuesToPop;
+    // nothing of the calling function is executed after the call
+    bool tailCall = false;
 
 	CallExpression(Expression *fun, Expression *arguments);
 
     ~CallExpression() override;
 
     void compile(CompilationState &state) override;
+
+    // compiles the intrinsic divmod(n, d), that returns the quotient and the remainder without a call
+    void compileDivmod(CompilationState &state);
 };
 
 struct VariableType : ASTNode {
@@ -546,6 +785,8 @@ struct FunctionStatement : Statement {
     vector<VariableDefinition*> *parameterVariables;
 	vector<ReturnVariableDefinition*> *returnVariables;
 	Statement *functionBody;
+    // declared with the 'inline' keyword
+    bool isInline = false;
 	FunctionStatement(
 					QualifiedName *qualifiedName,
 					vector<VariableDefinition*> *parameterVariables,
@@ -569,7 +810,7 @@ struct ReturnStatement : Statement {
 struct IOStatement : Statement {
 
     enum class IOFunction {
-        IOINPUT, IOOUTPUT
+        IOINPUT, IOOUTPUT, IODECIMALINPUT, IODECIMALOUTPUT
     } function;
 
     Expression *expr;
@@ -577,12 +818,19 @@ struct IOStatement : Statement {
     IOStatement(IOFunction function, Expression *expr)
             : function(function), expr(expr) {}
 
+    bool isInput() const {
+        return function == IOFunction::IOINPUT || function == IOFunction::IODECIMALINPUT;
+    }
+
     ~IOStatement() override {
         delete expr;
         expr = nullptr;
     }
 
     void compile(CompilationState &state) override;
+
+    // compiles the input or output of a single expression
+    void compile(CompilationState &state, Expression *e);
 };
 
 struct ExpressionStatement : Statement {
@@ -0,0 +1,520 @@
+//
+// Compiled input files, stored on disk and reused by later runs of the compiler
+//
+
+#include <cstdio>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include "cache.h"
+#include "print.h"
+
+// hash of the sources of the compiler, passed in by the build
+#ifndef BFC_SOURCE_HASH
+#define BFC_SOURCE_HASH ""
+#endif
+
+namespace {
+    // incremented whenever the stored format or the instructions change, like the BEGIN_IF and END_IF of version 2.
+    // The hash of the sources covers all other changes to the compiled functions
+    const std::string formatVersion = std::string("2 ") + BFC_SOURCE_HASH;
+
+    struct StoredVariable {
+        int line;
+        std::string file, name, type;
+        int length;
+        bool isPointerType, isArray;
+    };
+
+    struct StoredType {
+        int line;
+        std::string file, name;
+        vector<StoredVariable> members;
+    };
+
+    struct StoredFunction {
+        int line;
+        std::string file, name;
+        // qualified name of the extended type, or empty
+        std::string memberOf;
+        // visible to the following files, nested functions are not
+        bool exported, isMain, isInline;
+        label address;
+        vector<StoredVariable> returnValues, parameters;
+        vector<bool> readOnly;
+        vector<Instruction> code;
+        // kind and value of each label of 'code', in order
+        vector<std::pair<char, label>> labels;
+    };
+
+    struct Artifact {
+        // number of labels reserved by the file
+        label labels;
+        // qualified names of the functions of other files, that are jumped to
+        vector<std::string> imports;
+        vector<StoredType> types;
+        vector<StoredFunction> functions;
+    };
+
+    // 64 bit FNV-1a
+    uint64_t fnv1a(const std::string &data, uint64_t h = 14695981039346656037ull) {
+        for (unsigned char c : data) {
+            h ^= c;
+            h *= 1099511628211ull;
+        }
+        return h;
+    }
+
+    std::string join(const QualifiedName &qualified) {
+        std::string joined;
+        for (auto &name : qualified)
+            joined += (joined.empty() ? "" : ".") + name;
+        return joined;
+    }
+
+    QualifiedName split(const std::string &joined) {
+        QualifiedName qualified;
+        std::stringstream ss(joined);
+        std::string name;
+        while (std::getline(ss, name, '.'))
+            qualified.push_back(name);
+        return qualified;
+    }
+
+    // strings are stored with their length, as they may contain any character
+    void writeString(std::ostream &os, const std::string &str) {
+        os << str.size() << ':' << str << ' ';
+    }
+
+    bool readString(std::istream &is, std::string &str) {
+        size_t size;
+        if (!(is >> size) || is.get() != ':')
+            return false;
+        str.resize(size);
+        return static_cast<bool>(is.read(&str[0], size));
+    }
+
+    // calls 'f' on each field of 'i', except the labels
+    template<typename F>
+    void visitFields(Instruction &i, F f) {
+        switch (i.instr) {
+            case InstructionName::COPY:
+            case InstructionName::ADD_COPY:
+            case InstructionName::SUB_COPY:
+            case InstructionName::ADD_CARRY:
+            case InstructionName::SUB_CARRY:
+            case InstructionName::MUL:
+            case InstructionName::DIV:
+            case InstructionName::MOD:
+            case InstructionName::DIVMOD:
+            case InstructionName::LT:
+            case InstructionName::LE:
+            case InstructionName::GT:
+            case InstructionName::GE:
+            case InstructionName::EQ:
+            case InstructionName::NE:
+                f(i.copy.dst); f(i.copy.src); f(i.copy.aux); f(i.copy.size); f(i.copy.size_aux);
+                break;
+            case InstructionName::ILOAD:
+            case InstructionName::IADD:
+            case InstructionName::ISUB:
+            case InstructionName::IADD_CARRY:
+            case InstructionName::IMUL:
+            case InstructionName::IDIV:
+            case InstructionName::IMOD:
+            case InstructionName::IDIVMOD:
+                f(i.constant.dst); f(i.constant.size); f(i.constant.value); f(i.constant.aux);
+                break;
+            case InstructionName::MOVE:
+            case InstructionName::ADD:
+            case InstructionName::SUB:
+                f(i.move.dst); f(i.move.src); f(i.move.size);
+                break;
+            case InstructionName::COMPARE:
+                f(i.compare.conditionAddress); f(i.compare.size); f(i.compare.isZero); f(i.compare.notZero);
+                break;
+            case InstructionName::ARRAY_READ:
+            case InstructionName::ARRAY_WRITE:
+                f(i.array.array); f(i.array.index); f(i.array.value); f(i.array.size); f(i.array.length);
+                break;
+            case InstructionName::PUSH_STACK:
+            case InstructionName::POP_STACK:
+                f(i.stack.offset);
+                break;
+            case InstructionName::WRITE_INPUT:
+            case InstructionName::WRITE_OUTPUT:
+            case InstructionName::WRITE_DECIMAL_INPUT:
+            case InstructionName::WRITE_DECIMAL_OUTPUT:
+                f(i.io.src); f(i.io.size); f(i.io.aux); f(i.io.size_aux);
+                break;
+            case InstructionName::TEST:
+                f(i.test.isTrue); f(i.test.isFalse); f(i.test.jumpRegister);
+                break;
+            case InstructionName::BEGIN_IF:
+            case InstructionName::END_IF:
+                f(i.branch.condition);
+                break;
+            case InstructionName::CALL:
+                f(i.call.returnCell); f(i.call.aux);
+                break;
+            case InstructionName::RET:
+                f(i.ret.ret); f(i.ret.exit);
+                break;
+            case InstructionName::EXIT:
+                f(i.exit.exitCode);
+                break;
+            default:
+                break;
+        }
+    }
+
+    // calls 'f' on each label of 'i'
+    template<typename F>
+    void visitLabels(Instruction &i, F f) {
+        switch (i.instr) {
+            case InstructionName::TEST:
+                f(i.test.trueLabel); f(i.test.falseLabel);
+                break;
+            case InstructionName::CALL:
+                f(i.call.returnAddress);
+                break;
+            case InstructionName::JUMP:
+                f(i.jump.targetAddress);
+                break;
+            case InstructionName::LABEL:
+                f(i.label.address);
+                break;
+            default:
+                break;
+        }
+    }
+
+    // replaces the address after the '@' of a label or jump comment
+    void relabelComment(std::string &comment, label address) {
+        auto at = comment.rfind('@');
+        if (at != std::string::npos)
+            comment = comment.substr(0, at + 1) + to_string(address);
+    }
+
+    StoredVariable storeVariable(const SymbolResolutionResult &result) {
+        auto var = dynamic_cast<const VariableSymbol*>(result.resolved);
+        assert(var != nullptr);
+        return {var->line, var->file, var->name, join(var->type->getQualified()), var->length, var->isPointerType, var->isArray};
+    }
+
+    void writeVariable(std::ostream &os, const StoredVariable &var) {
+        os << var.line << ' ';
+        writeString(os, var.file);
+        writeString(os, var.name);
+        writeString(os, var.type);
+        os << var.length << ' ' << var.isPointerType << ' ' << var.isArray << '\n';
+    }
+
+    bool readVariable(std::istream &is, StoredVariable &var) {
+        return is >> var.line && readString(is, var.file) && readString(is, var.name) && readString(is, var.type)
+               && is >> var.length >> var.isPointerType >> var.isArray;
+    }
+
+    bool readVariables(std::istream &is, vector<StoredVariable> &vars) {
+        size_t count;
+        if (!(is >> count))
+            return false;
+        vars.resize(count);
+        for (auto &var : vars)
+            if (!readVariable(is, var))
+                return false;
+        return true;
+    }
+
+    // labels are stored relative to the first label of the file ('L'), as the index of an imported function ('F') or
+    // unchanged, if they don't refer to any label ('A')
+    void writeInstruction(std::ostream &os, Instruction i, label firstLabel, label lastLabel,
+                          const std::map<label, size_t> &imports) {
+        writeString(os, i.file);
+        os << i.line << ' ' << static_cast<int>(i.instr);
+        visitFields(i, [&](auto &field) { os << ' ' << field; });
+        visitLabels(i, [&](label &l) {
+            if (l > firstLabel && l <= lastLabel)
+                os << " L" << l - firstLabel;
+            else if (imports.count(l) != 0)
+                os << " F" << imports.at(l);
+            else
+                os << " A" << l;
+        });
+        os << ' ';
+        writeString(os, i.comment);
+        writeString(os, i.inlineStr);
+        os << '\n';
+    }
+
+    // the labels are relocated once the whole file is read
+    bool readInstruction(std::istream &is, Instruction &i, vector<std::pair<char, label>> &labels) {
+        int instr;
+        if (!readString(is, i.file) || !(is >> i.line >> instr))
+            return false;
+        i.instr = static_cast<InstructionName>(instr);
+        bool ok = true;
+        visitFields(i, [&](auto &field) { ok = ok && is >> field; });
+        visitLabels(i, [&](label &l) {
+            char kind;
+            ok = ok && is >> kind >> l && (kind == 'L' || kind == 'F' || kind == 'A');
+            labels.emplace_back(kind, l);
+        });
+        return ok && readString(is, i.comment) && readString(is, i.inlineStr);
+    }
+
+    bool readArtifact(std::istream &is, Artifact &artifact) {
+        std::string magic, version;
+        size_t count;
+        if (!(is >> magic) || magic != "bfc-artifact" || !readString(is, version) || version != formatVersion)
+            return false;
+        if (!(is >> artifact.labels >> count))
+            return false;
+        artifact.imports.resize(count);
+        for (auto &import : artifact.imports)
+            if (!readString(is, import))
+                return false;
+
+        if (!(is >> count))
+            return false;
+        artifact.types.resize(count);
+        for (auto &type : artifact.types)
+            if (!(is >> type.line) || !readString(is, type.file) || !readString(is, type.name) || !readVariables(is, type.members))
+                return false;
+
+        if (!(is >> count))
+            return false;
+        artifact.functions.resize(count);
+        for (auto &fun : artifact.functions) {
+            if (!(is >> fun.line) || !readString(is, fun.file) || !readString(is, fun.name) || !readString(is, fun.memberOf)
+                || !(is >> fun.exported >> fun.isMain >> fun.isInline >> fun.address))
+                return false;
+            if (!readVariables(is, fun.returnValues) || !readVariables(is, fun.parameters))
+                return false;
+            for (size_t k = 0; k < fun.parameters.size(); k++) {
+                bool readOnly;
+                if (!(is >> readOnly))
+                    return false;
+                fun.readOnly.push_back(readOnly);
+            }
+            if (!(is >> count))
+                return false;
+            for (size_t k = 0; k < count; k++) {
+                fun.code.emplace_back("", 0);
+                if (!readInstruction(is, fun.code.back(), fun.labels))
+                    return false;
+            }
+        }
+        std::string end;
+        return is >> end && end == "end";
+    }
+
+    void fail(const std::string &file, const std::string &message) {
+        errprintln(file + ": Error: Stored file doesn't match the files before it:", message);
+        exit(EXIT_FAILURE);
+    }
+
+    TypeSymbol *findType(SymbolTable &symbolTable, const std::string &file, const std::string &name) {
+        auto type = dynamic_cast<TypeSymbol*>(symbolTable.findGlobal(split(name)).resolved);
+        if (type == nullptr)
+            fail(file, "no type " + name);
+        return type;
+    }
+
+    // adds a variable to the current scope, like VariableDefinition::compile
+    SymbolResolutionResult declare(SymbolTable &symbolTable, const StoredVariable &var) {
+        auto symbol = symbolTable.create<VariableSymbol>(var.line, var.file, var.name, findType(symbolTable, var.file, var.type));
+        symbol->length = var.length;
+        symbol->isPointerType = var.isPointerType;
+        symbol->isArray = var.isArray;
+        symbolTable.add(*symbol);
+        return symbolTable.findGlobal(QualifiedName{var.name});
+    }
+}
+
+std::string ArtifactCache::key(const CompilationState &state, const std::string &content) {
+    auto h = fnv1a(previousKey);
+    h = fnv1a(formatVersion, h);
+    // options, that change the compiled instructions or their comments
+    h = fnv1a(to_string(state.cellBits) + " " + to_string(verboseSymbolNames), h);
+    h = fnv1a(state.currentFile, h);
+    h = fnv1a(content, h);
+    std::stringstream ss;
+    ss << std::hex << std::setw(16) << std::setfill('0') << h;
+    return previousKey = ss.str();
+}
+
+bool ArtifactCache::load(const std::string &key, CompilationState &state) {
+    Artifact artifact;
+    {
+        std::ifstream is(directory + "/" + key + ".bfo", std::ios::binary);
+        if (!is.is_open() || !readArtifact(is, artifact))
+            return false;
+    }
+    auto &symbolTable = state.symbolTable;
+
+    vector<label> imports;
+    for (auto &name : artifact.imports) {
+        auto fun = dynamic_cast<FunctionSymbol*>(symbolTable.findGlobal(split(name)).resolved);
+        if (fun == nullptr)
+            fail(name, "no function " + name);
+        imports.push_back(fun->address);
+    }
+    auto base = state.jumpAddressCounter;
+    state.reserveJumpAddresses(artifact.labels);
+
+    for (auto &type : artifact.types) {
+        auto symbol = symbolTable.create<TypeSymbol>(type.line, type.file, type.name);
+        symbolTable.add(*symbol);
+        symbolTable.push(*symbol);
+        for (auto &member : type.members)
+            declare(symbolTable, member);
+        symbolTable.pop();
+    }
+
+    for (auto &stored : artifact.functions) {
+        auto fun = symbolTable.create<FunctionSymbol>(stored.line, stored.file, stored.name, base + stored.address);
+        fun->isInline = stored.isInline;
+        fun->readOnly = stored.readOnly;
+        fun->code = stored.code;
+        auto storedLabel = stored.labels.begin();
+        for (auto &i : fun->code) {
+            visitLabels(i, [&](label &l) {
+                auto kind = storedLabel->first;
+                l = storedLabel->second;
+                if (kind == 'L')
+                    l += base;
+                else if (kind == 'F')
+                    l = imports.at(l);
+                storedLabel++;
+            });
+            if (i.instr == InstructionName::LABEL)
+                relabelComment(i.comment, i.label.address);
+            else if (i.instr == InstructionName::JUMP)
+                relabelComment(i.comment, i.jump.targetAddress);
+            else if (i.instr == InstructionName::TEST)
+                i.comment = "truebr@" + to_string(i.test.trueLabel) + ", falsebr@" + to_string(i.test.falseLabel)
+                            + ", jmpreg@" + to_string(i.test.jumpRegister);
+        }
+
+        // nested functions are only visible in their own file, they aren't declared again
+        if (stored.exported) {
+            // declare the function like FunctionStatement::compile, without its body
+            if (!stored.memberOf.empty()) {
+                fun->memberOf = findType(symbolTable, stored.file, stored.memberOf);
+                symbolTable.push(*fun->memberOf);
+            }
+            symbolTable.add(*fun);
+            symbolTable.push(*fun);
+            for (auto &var : stored.returnValues)
+                fun->returnValues.push_back(declare(symbolTable, var));
+            symbolTable.initFunctionStackframe(stored.file, stored.line, false);
+            for (auto &var : stored.parameters)
+                fun->parameters.push_back(declare(symbolTable, var));
+            symbolTable.pop();
+            if (fun->memberOf != nullptr)
+                symbolTable.pop();
+        }
+        if (stored.isMain) {
+            if (state.main != nullptr)
+                fail(stored.file, "main function already defined");
+            state.main = fun;
+        }
+        state.functions.push_back(fun);
+    }
+    return true;
+}
+
+void ArtifactCache::begin(const CompilationState &state) {
+    firstRootSymbol = state.symbolTable.scopeStack[0]->symbols.size();
+    firstFunction = state.functions.size();
+    firstLabel = state.jumpAddressCounter;
+}
+
+void ArtifactCache::store(const std::string &key, const CompilationState &state) {
+    auto root = state.symbolTable.scopeStack[0];
+    auto lastLabel = state.jumpAddressCounter;
+
+    // functions of the files before, that are jumped to
+    std::map<label, size_t> imports;
+    vector<std::string> importNames;
+    for (size_t f = 0; f < firstFunction; f++) {
+        for (size_t g = firstFunction; g < state.functions.size(); g++) {
+            for (auto &i : state.functions[g]->code) {
+                if (i.instr == InstructionName::JUMP && i.jump.targetAddress == state.functions[f]->address
+                    && imports.count(i.jump.targetAddress) == 0) {
+                    imports[i.jump.targetAddress] = importNames.size();
+                    importNames.push_back(join(state.functions[f]->getQualified()));
+                }
+            }
+        }
+    }
+
+    std::stringstream os;
+    os << "bfc-artifact ";
+    writeString(os, formatVersion);
+    os << '\n' << lastLabel - firstLabel << ' ' << importNames.size() << '\n';
+    for (auto &name : importNames)
+        writeString(os, name);
+
+    vector<const TypeSymbol*> types;
+    for (size_t s = firstRootSymbol; s < root->symbols.size(); s++)
+        if (auto type = dynamic_cast<const TypeSymbol*>(root->symbols[s]))
+            types.push_back(type);
+    os << '\n' << types.size() << '\n';
+    for (auto type : types) {
+        os << type->line << ' ';
+        writeString(os, type->file);
+        writeString(os, type->name);
+        // member functions are stored with the other functions
+        vector<SymbolResolutionResult> members;
+        for (auto member : type->symbols) {
+            if (dynamic_cast<VariableSymbol*>(member) != nullptr) {
+                members.emplace_back(root);
+                members.back().resolved = member;
+            }
+        }
+        os << members.size() << '\n';
+        for (auto &member : members)
+            writeVariable(os, storeVariable(member));
+    }
+
+    os << state.functions.size() - firstFunction << '\n';
+    for (size_t f = firstFunction; f < state.functions.size(); f++) {
+        auto fun = state.functions[f];
+        bool exported = fun->parent == root || dynamic_cast<const TypeSymbol*>(fun->parent) != nullptr;
+        os << fun->line << ' ';
+        writeString(os, fun->file);
+        writeString(os, fun->name);
+        writeString(os, fun->memberOf != nullptr ? join(fun->memberOf->getQualified()) : "");
+        os << exported << ' ' << (fun == state.main) << ' ' << fun->isInline << ' ' << fun->address - firstLabel << '\n';
+        os << (exported ? fun->returnValues.size() : 0) << '\n';
+        if (exported)
+            for (auto &var : fun->returnValues)
+                writeVariable(os, storeVariable(var));
+        os << (exported ? fun->parameters.size() : 0) << '\n';
+        if (exported) {
+            for (auto &var : fun->parameters)
+                writeVariable(os, storeVariable(var));
+            for (bool readOnly : fun->readOnly)
+                os << readOnly << ' ';
+        }
+        os << '\n' << fun->code.size() << '\n';
+        for (auto &i : fun->code)
+            writeInstruction(os, i, firstLabel, lastLabel, imports);
+    }
+    os << "end\n";
+
+    // write to a temporary file first, so that an interrupted run leaves no broken file behind
+    auto path = directory + "/" + key + ".bfo";
+    {
+        std::ofstream out(path + ".tmp", std::ios::binary);
+        if (!out.is_open()) {
+            errprintln("Could not store compiled file at", path);
+            return;
+        }
+        out << os.str();
+    }
+    std::rename((path + ".tmp").c_str(), path.c_str());
+}
@@ -0,0 +1,37 @@
+//
+// Compiled input files, stored on disk and reused by later runs of the compiler
+//
+
+#ifndef BFLANG_CACHE_H
+#define BFLANG_CACHE_H
+
+#include "bf.h"
+
+// Each input file is stored as the types and functions it adds to the program, with the instructions of the
+// functions and their labels relative to the file. A file is reused, as long as neither it nor one of the files
+// compiled before it changed, because it may use any of their symbols.
+struct ArtifactCache {
+    std::string directory;
+
+    explicit ArtifactCache(std::string directory) : directory(std::move(directory)) {}
+
+    // key of the input file, that is currently compiled, from its content and the keys of the files before it
+    std::string key(const CompilationState &state, const std::string &content);
+
+    // adds the symbols and functions of a stored file to 'state', returns false if the file isn't stored
+    bool load(const std::string &key, CompilationState &state);
+
+    // remembers, where the symbols and functions of the next input file will begin
+    void begin(const CompilationState &state);
+
+    // stores the symbols and functions added to 'state' since 'begin'
+    void store(const std::string &key, const CompilationState &state);
+
+private:
+    std::string previousKey;
+    size_t firstRootSymbol = 0;
+    size_t firstFunction = 0;
+    label firstLabel = 0;
+};
+
+#endif //BFLANG_CACHE_H
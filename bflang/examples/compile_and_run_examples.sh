@@ -1,28 +1,77 @@
-#/bin/bash
+#!/bin/bash
 EXAMPLE_DIR="."
-BFC="../cmake-build-release/bfc"
-BFI="../cmake-build-release/bfi"
+BFC="${BFC:-../cmake-build-release/bfc}"
+BFI="${BFI:-../cmake-build-release/bfi}"
 DST_DIR="$EXAMPLE_DIR/dst"
-SOURCE_FILES="characters.bl functions.bl io.bl member_functions.bl recursion.bl scopes.bl types.bl"
-mkdir $DST_DIR
+EXPECTED_DIR="$EXAMPLE_DIR/expected"
+SOURCE_FILES="characters.bl functions.bl io.bl member_functions.bl recursion.bl scopes.bl types.bl widths.bl"
+CELL_BITS="8 16 32"
+FAILED=0
+mkdir -p $DST_DIR
 echo "Compiling examples from $EXAMPLE_DIR with compiler=$BFC and interpreter=$BFI"
 
-for SRC_FILE in $SOURCE_FILES; do
-    # Compile the source file
-    echo "$BFC $SRC_FILE -I $EXAMPLE_DIR -o ${DST_DIR}/${SRC_FILE}.b"
-    $BFC $SRC_FILE -I $EXAMPLE_DIR -o ${DST_DIR}/${SRC_FILE}.b
+# Input of the examples, that read from stdin
+input() {
+    case $1 in
+        io) printf "abcd";;
+        widths) printf "300\n";;
+    esac
+}
 
-    # Run the source file
-    echo "$BFI $DST_DIR/${SRC_FILE}.b"
-    $BFI $DST_DIR/${SRC_FILE}.b
+# Compares the output of an example with expected/<name>.<bits>.out, or expected/<name>.out if it is the same on all widths
+check() {
+    local NAME=$1 BITS=$2 OUTPUT=$3
+    local EXPECTED="$EXPECTED_DIR/$NAME.$BITS.out"
+    [ -f "$EXPECTED" ] || EXPECTED="$EXPECTED_DIR/$NAME.out"
+    if cmp -s "$OUTPUT" "$EXPECTED"; then
+        echo "ok $NAME --cell-bits $BITS"
+    else
+        echo "FAILED $NAME --cell-bits $BITS, expected $EXPECTED:"
+        diff "$EXPECTED" "$OUTPUT"
+        FAILED=1
+    fi
+}
 
-    echo;
+for BITS in $CELL_BITS; do
+    for SRC_FILE in $SOURCE_FILES; do
+        NAME=${SRC_FILE%.bl}
+        BINARY=${DST_DIR}/${SRC_FILE}.${BITS}.b
+
+        # Compile the source file
+        echo "$BFC --cell-bits $BITS $SRC_FILE -I $EXAMPLE_DIR -o $BINARY"
+        $BFC --cell-bits $BITS $SRC_FILE -I $EXAMPLE_DIR -o $BINARY || { FAILED=1; continue; }
+
+        # Run the source file
+        echo "$BFI --cell-bits $BITS $BINARY"
+        input $NAME | $BFI --cell-bits $BITS $BINARY > $BINARY.out
+        check $NAME $BITS $BINARY.out
+    done
+
+    # Compile multiple files example
+    BINARY=${DST_DIR}/multiple_files_compiled.${BITS}.b
+    echo "$BFC --cell-bits $BITS -i math.bl multiple_files_compiled.bl -I $EXAMPLE_DIR -o $BINARY"
+    $BFC --cell-bits $BITS -i math.bl multiple_files_compiled.bl -I $EXAMPLE_DIR -o $BINARY || { FAILED=1; continue; }
+
+    # Run multiple files example
+    echo "$BFI --cell-bits $BITS $BINARY"
+    $BFI --cell-bits $BITS $BINARY > $BINARY.out
+    check multiple_files_compiled $BITS $BINARY.out
 done
 
-# Compile multuple files example
-echo "$BFC -i math.bl multiple_files_compiled.bl -I $EXAMPLE_DIR -o ${DST_DIR}/multiple_files_compiled.b"
-$BFC -i math.bl multiple_files_compiled.bl -I $EXAMPLE_DIR -o ${DST_DIR}/multiple_files_compiled.b
+# The first compilation with a cache directory stores each file, the second one reuses them and gives the same binary
+CACHE_DIR=${DST_DIR}/cache
+rm -rf $CACHE_DIR
+mkdir -p $CACHE_DIR
+for RUN in miss hit; do
+    echo "$BFC -v --cache-dir $CACHE_DIR -i math.bl multiple_files_compiled.bl -I $EXAMPLE_DIR -o ${DST_DIR}/cache_${RUN}.b"
+    $BFC -v --cache-dir $CACHE_DIR -i math.bl multiple_files_compiled.bl -I $EXAMPLE_DIR -o ${DST_DIR}/cache_${RUN}.b > ${DST_DIR}/cache_${RUN}.log
+done
+if grep -q "Compiling: math.bl" ${DST_DIR}/cache_miss.log && grep -q "Reusing: math.bl" ${DST_DIR}/cache_hit.log \
+        && grep -q "Reusing: multiple_files_compiled.bl" ${DST_DIR}/cache_hit.log && cmp -s ${DST_DIR}/cache_miss.b ${DST_DIR}/cache_hit.b; then
+    echo "ok cache miss and hit"
+else
+    echo "FAILED cache miss and hit"
+    FAILED=1
+fi
 
-# Run multiple files example
-echo "$BFI $DST_DIR/multiple_files_compiled.b"
-$BFI $DST_DIR/multiple_files_compiled.b
\ No newline at end of file
+exit $FAILED
@@ -2,13 +2,165 @@
 // Created by Marian Plivelic on 2017/07/22.
 //
 #include <iomanip>
+#include <cstdint>
 #include "interpreter.h"
 
 namespace po = boost::program_options;
 
-int main(int argc, const char* argv[]) {
-    using namespace std;
+using namespace std;
+
+namespace {
+    // settings of the interpreter, that don't depend on the width of the cells
+    struct Options {
+        bool verbose;
+        bool debug;
+        char debugInstruction;
+        bool debugi;
+        bool useBreakpoints;
+        std::vector<size_t> breakpoints;
+        bool numericalOutput;
+        bool numericalInput;
+        size_t memorySize;
+        char initValue;
+        unsigned constValue;
+        bool useStdin;
+        // values of --stdin in reverse order
+        vector<unsigned long> constInput;
+    };
+
+    // executes 'code' on a memory of 'Cell's, that wrap around like unsigned integers
+    template<typename Cell>
+    void run(Options &options, const std::string &code) {
+        struct {
+            Cell *ptrBegin, *ptrEnd, *ptr, *maximumUsage;
+            const char *pcBegin, *pcEnd, *pc;
+
+            void dump() {
+                cerr << "ptr: 0x" << hex << uppercase << ptr - ptrBegin << endl;
+                cerr << "pc: 0x" << hex << uppercase << pc - pcBegin << endl;
+                cerr << "usage: 0x" << hex << uppercase << maximumUsage - ptrBegin << endl;
+                const int line = 16;
+                for (auto i = ptrBegin; i < ptrEnd; i += line) {
+                    cerr << setfill('0') << setw(static_cast<int>(to_string(ptrEnd - ptrBegin).size()));
+                    cerr << hex << uppercase << i - ptrBegin << " |";
+                    for (auto j = i; j < i + line && j < ptrEnd; j++) {
+                        cerr << (j == ptr ? '>' : ' ') << setw(static_cast<int>(2 * sizeof(Cell))) << setfill('0') << hex << uppercase << (unsigned)*j;
+                    }
+                    cerr << " |";
+                    for (auto j = i; j < i + line && j < ptrEnd; j++) {
+                        cerr << (*j < 0x20 || *j > 0x7E ? '.' : (char) *j);
+                    }
+                    cerr << endl;
+                }
+            }
+        } state{};
+
+        state.maximumUsage = state.ptrBegin = state.ptr = new Cell[options.memorySize];
+        state.ptrEnd = state.ptrBegin + options.memorySize;
+        std::fill(state.ptr, state.ptr + options.memorySize, static_cast<Cell>(static_cast<unsigned char>(options.initValue)));
+
+        state.pcBegin = state.pc = code.c_str();
+        state.pcEnd = state.pcBegin + code.size();
 
+        while (state.pc != state.pcEnd && state.pc >= state.pcBegin) {
+            bool debugInstructionEncountered = options.debug && *state.pc == options.debugInstruction;
+            // write the interpreter state to cout
+            if (debugInstructionEncountered) {
+                state.dump();
+            }
+            // interrupt if debug instruction handler is 'interrupt' or if a breakpoint is encountered
+            if ((debugInstructionEncountered && options.debugi) ||
+                (options.useBreakpoints && find(options.breakpoints.begin(), options.breakpoints.end(), state.pc - state.pcBegin) != options.breakpoints.end())) {
+                cout << "Breakpoint at " << state.pc - state.pcBegin << " hit" << endl;
+                state.dump();
+                cerr << "Press enter to continue...";
+                cin.get();
+            }
+            switch (*state.pc) {
+                case '+': ++*state.ptr; break;
+                case '-': --*state.ptr; break;
+                case '>':
+                    ++state.ptr;
+                    if (state.ptr >= state.ptrEnd)
+                        throw std::runtime_error("pointer overflow at " + to_string(state.pc - state.pcBegin));
+                    if (state.ptr > state.maximumUsage)
+                        state.maximumUsage = state.ptr;
+                    break;
+                case '<':
+                    --state.ptr;
+                    if (state.ptr < state.ptrBegin)
+                        throw std::runtime_error("pointer underflow at " + to_string(state.pc - state.pcBegin));
+                    break;
+                case '.':
+                    if (options.numericalOutput)
+                        cout << (unsigned long) *state.ptr;
+                    else
+                        cout << (char) *state.ptr;
+                    break;
+                case ',':
+                    if (options.useStdin) {
+                        if (!options.constInput.empty()) {
+                            *state.ptr = static_cast<Cell>(options.constInput.back());
+                            options.constInput.pop_back();
+                        } else
+                            *state.ptr = static_cast<Cell>(options.constValue);
+                    } else {
+                        if (options.numericalInput) {
+                            std::string line;
+                            if (std::getline(cin, line))
+                                *state.ptr = static_cast<Cell>(atoll(line.c_str()));
+                        } else {
+                            unsigned char c;
+                            if (cin >> c)
+                                *state.ptr = c;
+                        }
+                    } break;
+                case '[':
+                // '[-]' and '[+]' clear the cell at once, on wide cells they would take up to 2^32 steps
+                if (*state.ptr != 0 && !options.useBreakpoints && state.pcEnd - state.pc >= 3 &&
+                    (state.pc[1] == '-' || state.pc[1] == '+') && state.pc[2] == ']') {
+                    *state.ptr = 0;
+                    state.pc += 2;
+                } else if (*state.ptr == 0) {
+                    int depth = 0;
+                    do {
+                        if (*state.pc == '[')
+                            ++depth;
+                        else if (*state.pc == ']')
+                            --depth;
+                        ++state.pc;
+                        if (state.pc >= state.pcEnd)
+                            throw std::runtime_error("program counter overflow");
+                    } while (depth != 0);
+                    --state.pc;
+                } break;
+                case ']':
+                if (*state.ptr != 0) {
+                    int depth = 0;
+                    do {
+                        if (*state.pc == '[')
+                            ++depth;
+                        else if (*state.pc == ']')
+                            --depth;
+                        --state.pc;
+                        if (state.pc >= state.pcEnd)
+                            throw std::runtime_error("program counter underflow");
+                    } while (depth != 0);
+                    ++state.pc;
+                } break;
+                case '@':
+                    if (options.verbose)
+                        cout << "Exit instruction encountered" << endl;
+                    exit(EXIT_SUCCESS);
+                default:
+                    break;
+            }
+            ++state.pc;
+        }
+    }
+}
+
+int main(int argc, const char* argv[]) {
     po::variables_map vm;
     po::options_description desc("This is a simple interpreter for the standard brainfuck bytecode.");
     try {
@@ -26,6 +178,7 @@ int main(int argc, const char* argv[]) {
                 ("stdin", po::value<std::vector<std::string>>()->multitoken(), "Uses a constant list of input values. Uses the value of --const if all values in --stdin are consumed.")
                 ("const,c", po::value<unsigned>()->default_value(0), "Value used if --stdin is empty")
                 ("memory,m", po::value<size_t>()->default_value(1024), "Sets the maximum amount of memory given to the program")
+                ("cell-bits", po::value<unsigned>()->default_value(8), "Width of a cell: 8, 16 or 32")
                 ("numerical-input,u", "Enables numerical input (e.g.: reads input '64' as 'A')")
                 ("numerical-output,U", "Enables numerical output (e.g.: prints '64' instead of 'A')")
                 ("verbose,v", "Verbose output");
@@ -37,10 +190,10 @@ int main(int argc, const char* argv[]) {
         return EXIT_FAILURE;
     }
 
-    bool verbose = false;
+    Options options;
 
-    if (vm.count("verbose"))
-        verbose = true;
+    options.verbose = static_cast<bool>(vm.count("verbose"));
+    bool verbose = options.verbose;
 
     if (vm.count("help")) {
         cout << desc;
@@ -52,43 +205,50 @@ int main(int argc, const char* argv[]) {
         return EXIT_FAILURE;
     }
 
-    bool debug = static_cast<bool>(vm.count("debug"));
-    char debugInstruction = debug ? vm["debug"].as<std::string>()[0] : '#';
+    options.debug = static_cast<bool>(vm.count("debug"));
+    options.debugInstruction = options.debug ? vm["debug"].as<std::string>()[0] : '#';
     if (verbose)
-        cout << "Debug mode: " << (debug ? to_string(debugInstruction) : string("off")) << endl;
+        cout << "Debug mode: " << (options.debug ? to_string(options.debugInstruction) : string("off")) << endl;
 
-    bool debugi = static_cast<bool>(vm.count("debug-interrupt"));
+    options.debugi = static_cast<bool>(vm.count("debug-interrupt"));
     if (verbose)
-        cout << "Debug interrupt handle method: " << (debugi ? "Interrupt" : "Continue") << endl;
+        cout << "Debug interrupt handle method: " << (options.debugi ? "Interrupt" : "Continue") << endl;
 
-    bool useBreakpoints = static_cast<bool>(vm.count("breakpoints"));
-    std::vector<size_t> breakpoints = useBreakpoints ? vm["breakpoints"].as<vector<size_t>>() : vector<size_t>();
+    options.useBreakpoints = static_cast<bool>(vm.count("breakpoints"));
+    options.breakpoints = options.useBreakpoints ? vm["breakpoints"].as<vector<size_t>>() : vector<size_t>();
     if (verbose)
-        cout << "Breakpoints: " << (useBreakpoints ? string("on") : string("off"));
+        cout << "Breakpoints: " << (options.useBreakpoints ? string("on") : string("off"));
 
-    bool numericalOutput = static_cast<bool>(vm.count("numerical-output"));
+    options.numericalOutput = static_cast<bool>(vm.count("numerical-output"));
     if (verbose)
-        cout << "Unsigned output: " << (numericalOutput ? string("on") : string("off")) << endl;
+        cout << "Unsigned output: " << (options.numericalOutput ? string("on") : string("off")) << endl;
 
-    bool numericalInput = static_cast<bool>(vm.count("numerical-input"));
+    options.numericalInput = static_cast<bool>(vm.count("numerical-input"));
     if (verbose)
-        cout << "Unsigned input: " << (numericalInput ? string("on") : string("off")) << endl;
+        cout << "Unsigned input: " << (options.numericalInput ? string("on") : string("off")) << endl;
 
-    size_t memorySize = vm["memory"].as<size_t>();
+    options.memorySize = vm["memory"].as<size_t>();
     if (verbose)
-        cout << "Memory size: " << memorySize << endl;
+        cout << "Memory size: " << options.memorySize << endl;
 
-    char initValue = vm["init"].as<char>();
+    unsigned cellBits = vm["cell-bits"].as<unsigned>();
+    if (cellBits != 8 && cellBits != 16 && cellBits != 32) {
+        cerr << "Invalid cell width " << cellBits << endl;
+        return EXIT_FAILURE;
+    }
     if (verbose)
-        cout << "Initial value: " << (int) initValue << endl;
+        cout << "Cell width: " << cellBits << endl;
 
-    unsigned constValue = vm["const"].as<unsigned>();
+    options.initValue = vm["init"].as<char>();
+    if (verbose)
+        cout << "Initial value: " << (int) options.initValue << endl;
 
-    bool useStdin = static_cast<bool>(vm.count("stdin"));
-    vector<unsigned char> constInput;
-    if (useStdin)
+    options.constValue = vm["const"].as<unsigned>();
+
+    options.useStdin = static_cast<bool>(vm.count("stdin"));
+    if (options.useStdin)
         for (auto str : vm["stdin"].as<vector<string>>())
-            constInput.insert(constInput.begin(), (unsigned char) atoi(str.c_str()));
+            options.constInput.insert(options.constInput.begin(), strtoul(str.c_str(), nullptr, 10));
 
     std::string code;
     {
@@ -110,122 +270,10 @@ int main(int argc, const char* argv[]) {
     if (verbose)
         cout << "running " << vm["input"].as<string>() << " ..." << endl;
 
-    struct {
-        unsigned char *ptrBegin, *ptrEnd, *ptr, *maximumUsage;
-        const char *pcBegin, *pcEnd, *pc;
-
-        void dump() {
-            cerr << "ptr: 0x" << hex << uppercase << ptr - ptrBegin << endl;
-            cerr << "pc: 0x" << hex << uppercase << pc - pcBegin << endl;
-            cerr << "usage: 0x" << hex << uppercase << maximumUsage - ptrBegin << endl;
-            const int line = 16;
-            for (auto i = ptrBegin; i < ptrEnd; i += line) {
-                cerr << setfill('0') << setw(static_cast<int>(to_string(ptrEnd - ptrBegin).size()));
-                cerr << hex << uppercase << i - ptrBegin << " |";
-                for (auto j = i; j < i + line && j < ptrEnd; j++) {
-                    cerr << (j == ptr ? '>' : ' ') << setw(2) << setfill('0') << hex << uppercase << (unsigned)*j;
-                }
-                cerr << " |";
-                for (auto j = i; j < i + line && j < ptrEnd; j++) {
-                    cerr << (*j < 0x20 || *j > 0x7E ? '.' : (char) *j);
-                }
-                cerr << endl;
-            }
-        }
-    } state{};
-
-    state.maximumUsage = state.ptrBegin = state.ptr = new unsigned char[memorySize];
-    state.ptrEnd = state.ptrBegin + memorySize;
-    std::fill(state.ptr, state.ptr + memorySize, initValue);
-
-    state.pcBegin = state.pc = code.c_str();
-    state.pcEnd = state.pcBegin + code.size();
-
-    while (state.pc != state.pcEnd && state.pc >= state.pcBegin) {
-        bool debugInstructionEncountered = debug && *state.pc == debugInstruction;
-        // write the interpreter state to cout
-        if (debugInstructionEncountered) {
-            state.dump();
-        }
-        // interrupt if debug instruction handler is 'interrupt' or if a breakpoint is encountered
-        if ((debugInstructionEncountered && debugi) ||
-            (useBreakpoints && find(breakpoints.begin(), breakpoints.end(), state.pc - state.pcBegin) != breakpoints.end())) {
-            cout << "Breakpoint at " << state.pc - state.pcBegin << " hit" << endl;
-            state.dump();
-            cerr << "Press enter to continue...";
-            cin.get();
-        }
-        switch (*state.pc) {
-            case '+': ++*state.ptr; break;
-            case '-': --*state.ptr; break;
-            case '>':
-                ++state.ptr;
-                if (state.ptr >= state.ptrEnd)
-                    throw std::runtime_error("pointer overflow at " + to_string(state.pc - state.pcBegin));
-                if (state.ptr > state.maximumUsage)
-                    state.maximumUsage = state.ptr;
-                break;
-            case '<':
-                --state.ptr;
-                if (state.ptr < state.ptrBegin)
-                    throw std::runtime_error("pointer underflow at " + to_string(state.pc - state.pcBegin));
-                break;
-            case '.':
-                if (numericalOutput)
-                    cout << (unsigned) *state.ptr;
-                else
-                    cout << *state.ptr;
-                break;
-            case ',':
-                if (useStdin) {
-                    if (!constInput.empty()) {
-                        *state.ptr = (unsigned char) constInput.back();
-                        constInput.pop_back();
-                    } else
-                        *state.ptr = static_cast<unsigned char>(constValue);
-                } else {
-                    if (numericalInput) {
-                        std::string line;
-                        if (std::getline(cin, line))
-                            *state.ptr = static_cast<unsigned char>(atoi(line.c_str()));
-                    } else
-                        cin >> *state.ptr;
-                } break;
-            case '[':
-            if (*state.ptr == 0) {
-                int depth = 0;
-                do {
-                    if (*state.pc == '[')
-                        ++depth;
-                    else if (*state.pc == ']')
-                        --depth;
-                    ++state.pc;
-                    if (state.pc >= state.pcEnd)
-                        throw std::runtime_error("program counter overflow");
-                } while (depth != 0);
-                --state.pc;
-            } break;
-            case ']':
-            if (*state.ptr != 0) {
-                int depth = 0;
-                do {
-                    if (*state.pc == '[')
-                        ++depth;
-                    else if (*state.pc == ']')
-                        --depth;
-                    --state.pc;
-                    if (state.pc >= state.pcEnd)
-                        throw std::runtime_error("program counter underflow");
-                } while (depth != 0);
-                ++state.pc;
-            } break;
-            case '@':
-                if (verbose)
-                    cout << "Exit instruction encountered" << endl;
-                exit(EXIT_SUCCESS);
-            default:
-                break;
-        }
-        ++state.pc;
-    }
-}
\ No newline at end of file
+    if (cellBits == 8)
+        run<uint8_t>(options, code);
+    else if (cellBits == 16)
+        run<uint16_t>(options, code);
+    else
+        run<uint32_t>(options, code);
+}
@@ -1,44 +1,21 @@
 #include <fstream>
 #include <sstream>
+#include <algorithm>
+#include <memory>
+#include <thread>
 #include <boost/program_options.hpp>
 #include "bf.h"
+#include "optimizer.h"
+#include "cache.h"
 #include "print.h"
 
 namespace po = boost::program_options;
 
-std::string currentFile;
-std::ofstream binary_output_stream;
-std::ofstream intermediate_output_stream;
 bool verbose;
 bool verboseSymbolTable;
 bool debug;
 bool verboseSymbolNames;
 
-// implementation
-void yyerror(const char *s) {
-    fprintf(stderr, "%s:%i Error: %s\n", currentFile.c_str(), yylineno, s);
-    exit(EXIT_FAILURE);
-}
-
-std::string optimize(std::string &buffer, std::string line) {
-    for (char c : line) {
-        if (buffer.size() == 0 || c == buffer.back())
-            // add character to buffer if it is a repetition
-            buffer.push_back(c);
-        else if ((c == '+' && buffer.back() == '-')
-                || (c == '-' && buffer.back() == '+')
-                || (c == '>' && buffer.back() == '<')
-                || (c == '<' && buffer.back() == '>'))
-            // if the characters are opposites, remove both
-            buffer.erase(buffer.size() - 1);
-        else {
-            // if they are unreleated, add the buffer to the output and clear it
-            buffer.push_back(c);
-        }
-    }
-    return buffer;
-}
-
 int main(int argc, char const* const*argv) {
 
     po::variables_map vm;
@@ -56,7 +33,11 @@ int main(int argc, char const* const*argv) {
                 ("output-symbol-table", po::value<std::string>(), "file for the symbol table")
                 ("verbose-symbol-table", "more verbose symbol table output")
                 ("verbose,v", "verbose output to std::out")
-                ("optimization,O", po::value<unsigned>()->default_value(1), "Optimization level. 0=off, 1=on.")
+                ("optimization,O", po::value<unsigned>()->default_value(1), "Optimization level 0-3. 0=off, 1=cheap passes and the optimizations of the code generation, 2 and 3=more expensive passes.")
+                ("disable-pass", po::value<std::vector<std::string>>()->multitoken(), "Names of optimization passes to skip")
+                ("cell-bits", po::value<unsigned>()->default_value(8), "Width of the cells of the target interpreter: 8, 16 or 32")
+                ("jobs,j", po::value<unsigned>()->default_value(0), "Number of threads writing the code of the functions, 0 for one per processor")
+                ("cache-dir", po::value<std::string>(), "Directory to store compiled input files in, unchanged files are reused by the next compilation")
                 ("verbose-symbol-names,V", "displays full path of all symbols")
                 ("debug,d", "compiles with debug information");
 
@@ -84,10 +65,44 @@ int main(int argc, char const* const*argv) {
     if (verbose)
         println("Debug symbols:", debug ? "on" : "off");
 
-    int optimizationLevel = vm["optimization"].as<unsigned>();
+    unsigned optimizationLevel = vm["optimization"].as<unsigned>();
+    if (optimizationLevel > 3) {
+        errprintln("Invalid optimization level", optimizationLevel);
+        return EXIT_FAILURE;
+    }
     if (verbose)
         println("Optimization level: ", optimizationLevel);
 
+    CompilationState state;
+
+    state.cellBits = (int) vm["cell-bits"].as<unsigned>();
+    if (state.cellBits != 8 && state.cellBits != 16 && state.cellBits != 32) {
+        errprintln("Invalid cell width", state.cellBits);
+        return EXIT_FAILURE;
+    }
+    if (verbose)
+        println("Cell width: ", state.cellBits);
+
+    state.jobs = vm["jobs"].as<unsigned>();
+    if (state.jobs == 0)
+        state.jobs = std::max(1u, std::thread::hardware_concurrency());
+    if (verbose)
+        println("Threads: ", state.jobs);
+
+    PassManager passManager(optimizationLevel);
+    passManager.addDefaultPasses();
+    if (vm.count("disable-pass"))
+        for (const auto &name : vm["disable-pass"].as<std::vector<std::string>>())
+            passManager.disabled.insert(name);
+
+    // the optimizations of the code generation are switched like the passes of level 1
+    auto enabled = [&](const std::string &name) { return optimizationLevel >= 1 && passManager.disabled.count(name) == 0; };
+    state.moveLastUse = enabled("last-use");
+    state.tailCalls = enabled("tail-calls");
+    state.foldConstants = enabled("fold-constants");
+    state.lendArguments = enabled("lend-arguments");
+    state.symbolTable.reuseTemporaries = enabled("reuse-temporaries");
+
     verboseSymbolTable = static_cast<bool>(vm.count("verbose-symbol-table"));
     if (verbose)
         println("Verbose symbol table:", verboseSymbolTable ? "on" : "off");
@@ -96,96 +111,90 @@ int main(int argc, char const* const*argv) {
     if (verbose)
         println("Verbose symbol names:", verboseSymbolNames ? "on" : "off");
 
-
-    CompilationState state;
-
     auto output_path = vm["output"].as<std::string>();
-    if (!output_path.empty()) {
-        binary_output_stream.open(output_path);
-        if (!binary_output_stream.is_open()) {
-            errprintln("Could not create destination for compiled binary file at", output_path);
-            return EXIT_FAILURE;
-        }
-        if (verbose)
-            println("Writing binary to", output_path);
-    } else if (verbose) {
+    if (output_path.empty() && verbose) {
         errprintln("Invalid output file name");
         return EXIT_FAILURE;
     }
 
+    std::string intermediate_path;
     if (vm.count("output-intermediate")) {
-        auto output_path = vm["output-intermediate"].as<std::string>();
-        if (!output_path.empty()) {
-            intermediate_output_stream.open(output_path);
-            if (!intermediate_output_stream) {
-                errprintln("Could not create destination for intermediate bytecode file at", output_path);
-                return EXIT_FAILURE;
-            }
-            if (verbose)
-                println("Writing intermediate to", output_path);
-        } else if (verbose) {
+        intermediate_path = vm["output-intermediate"].as<std::string>();
+        if (intermediate_path.empty() && verbose) {
             errprintln("Invalid destination for intermediate output");
             return EXIT_FAILURE;
         }
     } else if (verbose)
         println("No intermediate file will be generated");
 
+    std::unique_ptr<ArtifactCache> cache;
+    if (vm.count("cache-dir")) {
+        cache.reset(new ArtifactCache(vm["cache-dir"].as<std::string>()));
+        if (verbose)
+            println("Cache directory:", cache->directory);
+    }
+
     for (const auto &inputFilePath : vm["input"].as<std::vector<std::string>>()) {
-        currentFile = inputFilePath;
-        yyin = fopen(currentFile.c_str(), "r");
+        state.currentFile = inputFilePath;
+        auto input = fopen(state.currentFile.c_str(), "r");
 
-        if ((yyin == nullptr) && vm.count("import-path")) {
+        if ((input == nullptr) && vm.count("import-path")) {
             for (const auto &importPath : vm["import-path"].as<std::vector<std::string>>()) {
                 auto concatPath = importPath + "/" + inputFilePath;
-                currentFile = concatPath;
-                if ((yyin = fopen(concatPath.c_str(), "r")) != nullptr)
+                state.currentFile = concatPath;
+                if ((input = fopen(concatPath.c_str(), "r")) != nullptr)
                     break;
             }
         }
 
-        if (yyin != nullptr) {
-            if (verbose)
-                println("Compiling:", currentFile);
-            yyrestart(yyin);
-        } else {
-            errprintln("Can't locate input file '" + currentFile + "'");
+        if (input == nullptr) {
+            errprintln("Can't locate input file '" + state.currentFile + "'");
             return EXIT_FAILURE;
         }
 
-        yyparse();
-        fclose(yyin);
-        yyin = nullptr;
+        std::string key;
+        if (cache) {
+            std::string content;
+            char buffer[4096];
+            size_t read;
+            while ((read = fread(buffer, 1, sizeof(buffer), input)) > 0)
+                content.append(buffer, read);
+            rewind(input);
+
+            key = cache->key(state, content);
+            if (cache->load(key, state)) {
+                if (verbose)
+                    println("Reusing:", state.currentFile);
+                fclose(input);
+                continue;
+            }
+            cache->begin(state);
+        }
 
-        if (bisonAST == nullptr) {
-            errprintln("Failed to compile", currentFile);
+        if (verbose)
+            println("Compiling:", state.currentFile);
+        auto ast = parse(state, input);
+        fclose(input);
+
+        if (ast == nullptr) {
+            errprintln("Failed to compile", state.currentFile);
             return EXIT_FAILURE;
         }
 
-        bisonAST->function = state.symbolTable.currentScope();
-        bisonAST->compile(state);
+        ast->function = state.symbolTable.currentScope();
+        ast->compile(state);
 
         if (!(state.symbolTable.scopeStack.size() == 1 && state.symbolTable.scopeStack[0]->name == "__root__")) {
             errprintln("Scopes not properly deconstructed");
             return EXIT_FAILURE;
         }
 
-        delete bisonAST;
-        bisonAST = nullptr;
-        yylineno = 0;
-    }
+        delete ast;
+        // frees all nodes of the file at once, the symbols and instructions don't refer to them
+        state.nodes.release();
 
-    if (binary_output_stream.is_open()) {
-        binary_output_stream.flush();
-        binary_output_stream.close();
-        if (verbose)
-            println("Binary output stream closed");
-    }
-
-    if (intermediate_output_stream.is_open()) {
-        intermediate_output_stream.flush();
-        intermediate_output_stream.close();
-        if (verbose)
-            println("Intermediate output stream closed");
+        if (cache)
+            cache->store(key, state);
     }
 
     if (vm.count("output-symbol-table") != 0u) {
@@ -208,29 +217,40 @@ int main(int argc, char const* const*argv) {
         exit(EXIT_FAILURE);
     }
 
-    if (!debug) {
-        auto output_path = vm["output"].as<std::string>();
-        if (output_path.size() == 0)
-            exit(EXIT_SUCCESS);
-        ofstream out(output_path + ".tmp");
-        assert(out.is_open());
-        {
-            string line;
-            out << ">>" << string(static_cast<unsigned long>(state.main->address), '+') << ">+[";
-            ifstream iout(output_path);
-            if (optimizationLevel == 1) {
-                string buffer;
-                while (getline(iout, line))
-                    optimize(buffer, line);
-                out << buffer;
-            } else {
-                while (getline(iout, line))
-                    out << line;
-            }
-            out << "]";
-            out.flush();
+    passManager.run(state);
+
+    if (!intermediate_path.empty()) {
+        ofstream intermediate(intermediate_path);
+        if (!intermediate.is_open()) {
+            errprintln("Could not create destination for intermediate bytecode file at", intermediate_path);
+            return EXIT_FAILURE;
         }
-        out.close();
-        rename((output_path + ".tmp").c_str(), output_path.c_str());
+        if (verbose)
+            println("Writing intermediate to", intermediate_path);
+        emitIntermediate(intermediate, state);
     }
-}
\ No newline at end of file
+
+    if (output_path.empty())
+        exit(EXIT_SUCCESS);
+
+    std::stringstream ss;
+    emitBinary(ss, state);
+    std::string binary = ss.str();
+
+    if (!debug) {
+        binary.erase(std::remove(binary.begin(), binary.end(), '\n'), binary.end());
+        passManager.run(state, binary);
+    }
+
+    ofstream out(output_path);
+    if (!out.is_open()) {
+        errprintln("Could not create destination for compiled binary file at", output_path);
+        return EXIT_FAILURE;
+    }
+    if (verbose)
+        println("Writing binary to", output_path);
+    if (!debug)
+        out << ">>" << string(static_cast<unsigned long>(state.main->address), '+') << ">+[" << binary << "]";
+    else
+        out << binary;
+}
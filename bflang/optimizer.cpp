@@ -0,0 +1,784 @@
+#include <algorithm>
+#include <map>
+#include "optimizer.h"
+#include "print.h"
+
+namespace {
+    // Merges consecutive stack instructions and drops the ones, that don't move the pointer
+    struct StackMergePass : Pass {
+        StackMergePass() : Pass("stack-merge", 1) {}
+
+        static cellValue delta(const Instruction &i) {
+            return i.instr == InstructionName::PUSH_STACK ? i.stack.offset : -i.stack.offset;
+        }
+
+        void runOnFunction(CompilationState &, FunctionSymbol &function) override {
+            vector<Instruction> out;
+            out.reserve(function.code.size());
+            for (auto &i : function.code) {
+                if (i.instr == InstructionName::NOP)
+                    continue;
+                bool isStack = i.instr == InstructionName::PUSH_STACK || i.instr == InstructionName::POP_STACK;
+                if (isStack && !out.empty()
+                    && (out.back().instr == InstructionName::PUSH_STACK || out.back().instr == InstructionName::POP_STACK)) {
+                    auto offset = delta(out.back()) + delta(i);
+                    out.back().instr = offset >= 0 ? InstructionName::PUSH_STACK : InstructionName::POP_STACK;
+                    out.back().stack.offset = offset >= 0 ? offset : -offset;
+                    if (offset == 0)
+                        out.pop_back();
+                } else if (!isStack || i.stack.offset != 0) {
+                    out.push_back(i);
+                }
+            }
+            function.code.swap(out);
+        }
+    };
+
+    // Replaces calls of small functions and of functions declared 'inline' with a copy of their body.
+    // The body runs on the callee's frame, so the arguments are used in the cells they were pushed to.
+    struct InlinePass : Pass {
+        InlinePass() : Pass("inline", 2) {}
+
+        // functions with at most this many instructions are inlined without the keyword
+        static const size_t sizeLimit = 24;
+
+        std::map<label, FunctionSymbol*> functions;
+
+        static bool isRecursive(const FunctionSymbol &function) {
+            for (auto &i : function.code)
+                if (i.instr == InstructionName::JUMP && i.jump.targetAddress == function.address)
+                    return true;
+            return false;
+        }
+
+        // tail calls jump to another function without a return label, and the function doesn't end with RET
+        bool hasTailCall(const FunctionSymbol &function) const {
+            auto &code = function.code;
+            if (code.empty() || code.back().instr != InstructionName::RET)
+                return true;
+            for (size_t k = 0; k < code.size(); k++) {
+                if (code[k].instr != InstructionName::JUMP || functions.count(code[k].jump.targetAddress) == 0)
+                    continue;
+                auto call = k > 0 && code[k - 1].instr == InstructionName::PUSH_STACK ? k - 1 : k;
+                if (call == 0 || code[call - 1].instr != InstructionName::CALL)
+                    return true;
+            }
+            return false;
+        }
+
+        static void shift(vector<Instruction> &out, const Instruction &at, cellValue offset) {
+            if (offset == 0)
+                return;
+            Instruction i(at.file, at.line, offset > 0 ? InstructionName::PUSH_STACK : InstructionName::POP_STACK);
+            i.stack.offset = offset > 0 ? offset : -offset;
+            out.push_back(i);
+        }
+
+        // offset of an optional stack instruction at 'index'
+        static cellValue stackOffset(const vector<Instruction> &code, size_t &index, InstructionName instr) {
+            if (index < code.size() && code[index].instr == instr)
+                return code[index++].stack.offset;
+            return 0;
+        }
+
+        // copies the body of 'callee' with new addresses for its labels
+        static void expand(CompilationState &state, vector<Instruction> &out, const FunctionSymbol &callee, size_t begin, size_t end) {
+            std::map<label, label> labels;
+            for (auto i = begin; i < end; i++)
+                if (callee.code[i].instr == InstructionName::LABEL)
+                    labels[callee.code[i].label.address] = state.newJumpAddress();
+            auto rename = [&](label &l) {
+                auto renamed = labels.find(l);
+                if (renamed != labels.end())
+                    l = renamed->second;
+            };
+            for (auto k = begin; k < end; k++) {
+                auto i = callee.code[k];
+                switch (i.instr) {
+                    case InstructionName::LABEL:
+                        rename(i.label.address);
+                        i.comment = i.comment.substr(0, i.comment.rfind('@') + 1) + to_string(i.label.address);
+                        break;
+                    case InstructionName::JUMP:
+                        rename(i.jump.targetAddress);
+                        break;
+                    case InstructionName::CALL:
+                        rename(i.call.returnAddress);
+                        break;
+                    case InstructionName::TEST:
+                        rename(i.test.trueLabel);
+                        rename(i.test.falseLabel);
+                        i.comment = "truebr@" + to_string(i.test.trueLabel) + ", falsebr@" + to_string(i.test.falseLabel)
+                                    + ", jmpreg@" + to_string(i.test.jumpRegister);
+                        break;
+                    default:
+                        break;
+                }
+                out.push_back(i);
+            }
+        }
+
+        void runOnProgram(CompilationState &state) override {
+            functions.clear();
+            for (auto fun : state.functions)
+                functions[fun->address] = fun;
+            // callees are defined before their callers, so their calls are already expanded
+            Pass::runOnProgram(state);
+        }
+
+        void runOnFunction(CompilationState &state, FunctionSymbol &function) override {
+            vector<Instruction> out;
+            auto &code = function.code;
+            for (size_t k = 0; k < code.size(); k++) {
+                if (code[k].instr != InstructionName::CALL) {
+                    out.push_back(code[k]);
+                    continue;
+                }
+                // a call is 'CALL, PUSH_STACK, JUMP, LABEL, POP_STACK', where the stack instructions are optional
+                auto next = k + 1;
+                auto arguments = stackOffset(code, next, InstructionName::PUSH_STACK);
+                if (next + 1 >= code.size() || code[next].instr != InstructionName::JUMP
+                    || code[next + 1].instr != InstructionName::LABEL
+                    || code[next + 1].label.address != code[k].call.returnAddress) {
+                    out.push_back(code[k]);
+                    continue;
+                }
+                auto callee = functions.find(code[next].jump.targetAddress);
+                if (callee == functions.end() || callee->second == &function || isRecursive(*callee->second)
+                    || hasTailCall(*callee->second)
+                    || (!callee->second->isInline && callee->second->code.size() > sizeLimit)) {
+                    out.push_back(code[k]);
+                    continue;
+                }
+                next += 2;
+                stackOffset(code, next, InstructionName::POP_STACK);
+
+                // the callee's code is 'LABEL, POP_STACK, body, RET'
+                auto &calleeCode = callee->second->code;
+                size_t begin = 1;
+                auto frame = arguments - stackOffset(calleeCode, begin, InstructionName::POP_STACK);
+                shift(out, code[k], frame);
+                expand(state, out, *callee->second, begin, calleeCode.size() - 1);
+                shift(out, code[k], -frame);
+                k = next - 1;
+            }
+            code.swap(out);
+        }
+    };
+
+    // Removes functions, that can't be reached from main, and blocks, whose label is never jumped to.
+    // The remaining labels are numbered in the order they are emitted, as each label costs its address in the dispatcher.
+    struct DeadCodePass : Pass {
+        DeadCodePass() : Pass("dead-code", 1) {}
+
+        // labels, that are jumped to by 'i' directly, by a return or by a conditional jump
+        static void targets(const Instruction &i, std::set<label> &out) {
+            switch (i.instr) {
+                case InstructionName::JUMP:
+                    out.insert(i.jump.targetAddress); break;
+                case InstructionName::CALL:
+                    out.insert(i.call.returnAddress); break;
+                case InstructionName::TEST:
+                    out.insert(i.test.trueLabel);
+                    out.insert(i.test.falseLabel);
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        static void renameComment(std::string &comment, label address) {
+            auto at = comment.rfind('@');
+            if (at != std::string::npos)
+                comment = comment.substr(0, at + 1) + to_string(address);
+        }
+
+        static void removeFunctions(CompilationState &state) {
+            std::map<label, FunctionSymbol*> functions;
+            for (auto fun : state.functions)
+                functions[fun->address] = fun;
+            std::set<FunctionSymbol*> reachable{state.main};
+            vector<FunctionSymbol*> worklist{state.main};
+            while (!worklist.empty()) {
+                auto fun = worklist.back();
+                worklist.pop_back();
+                for (auto &i : fun->code) {
+                    auto callee = i.instr == InstructionName::JUMP ? functions.find(i.jump.targetAddress) : functions.end();
+                    if (callee != functions.end() && reachable.insert(callee->second).second)
+                        worklist.push_back(callee->second);
+                }
+            }
+            vector<FunctionSymbol*> used;
+            for (auto fun : state.functions) {
+                if (reachable.count(fun))
+                    used.push_back(fun);
+                else if (verbose)
+                    println("Removing unused function", fun->name);
+            }
+            state.functions.swap(used);
+        }
+
+        // blocks are only entered through the dispatcher, so a block without jumps to its label is dead
+        static bool removeBlocks(CompilationState &state) {
+            std::set<label> used{state.main->address};
+            for (auto fun : state.functions)
+                for (auto &i : fun->code)
+                    targets(i, used);
+            bool changed = false;
+            for (auto fun : state.functions) {
+                vector<Instruction> out;
+                bool dead = false;
+                for (auto &i : fun->code) {
+                    if (i.instr == InstructionName::LABEL)
+                        dead = used.count(i.label.address) == 0;
+                    if (!dead)
+                        out.push_back(i);
+                }
+                changed |= out.size() != fun->code.size();
+                fun->code.swap(out);
+            }
+            return changed;
+        }
+
+        static void renumber(CompilationState &state) {
+            std::map<label, label> labels;
+            for (auto fun : state.functions)
+                for (auto &i : fun->code)
+                    if (i.instr == InstructionName::LABEL)
+                        labels.emplace(i.label.address, labels.size() + 1);
+            auto rename = [&](label &l) {
+                auto renamed = labels.find(l);
+                if (renamed != labels.end())
+                    l = renamed->second;
+            };
+            for (auto fun : state.functions) {
+                rename(fun->address);
+                for (auto &i : fun->code) {
+                    switch (i.instr) {
+                        case InstructionName::LABEL:
+                            rename(i.label.address);
+                            renameComment(i.comment, i.label.address);
+                            break;
+                        case InstructionName::JUMP:
+                            rename(i.jump.targetAddress);
+                            renameComment(i.comment, i.jump.targetAddress);
+                            break;
+                        case InstructionName::CALL:
+                            rename(i.call.returnAddress);
+                            break;
+                        case InstructionName::TEST:
+                            rename(i.test.trueLabel);
+                            rename(i.test.falseLabel);
+                            i.comment = "truebr@" + to_string(i.test.trueLabel) + ", falsebr@" + to_string(i.test.falseLabel)
+                                        + ", jmpreg@" + to_string(i.test.jumpRegister);
+                            break;
+                        default:
+                            break;
+                    }
+                }
+            }
+        }
+
+        void runOnProgram(CompilationState &state) override {
+            removeFunctions(state);
+            while (removeBlocks(state));
+            renumber(state);
+        }
+    };
+
+    // Tracks the values of cells through the straight-line code of each block.
+    // Clears of cells, that are known to be zero, are removed by replacing MOVE and COPY with their adding forms,
+    // and ILOADs of cells with a known value become the difference to that value.
+    struct KnownValuePass : Pass {
+        KnownValuePass() : Pass("known-values", 2) {}
+
+        // known values relative to the current stack base
+        std::map<cellReference, cellValue> known;
+        // number of values of a cell
+        cellValue range = 0;
+
+        cellValue wrap(cellValue value) const {
+            return ((value % range) + range) % range;
+        }
+
+        // length of the plain code, that adds 'value'
+        cellValue cost(cellValue value) const {
+            return std::min(wrap(value), range - wrap(value));
+        }
+
+        bool isZero(cellReference cell, cellSize size) const {
+            for (int i = 0; i < size; i++) {
+                auto k = known.find(cell + i);
+                if (k == known.end() || k->second != 0)
+                    return false;
+            }
+            return true;
+        }
+
+        void set(cellReference cell, cellValue value) {
+            known[cell] = wrap(value);
+        }
+
+        // adds 'sign' times the value of src to dst, dst is unknown afterwards if src is unknown
+        void add(cellReference dst, cellReference src, cellSize size, cellValue sign) {
+            for (int i = 0; i < size; i++) {
+                auto d = known.find(dst + i), s = known.find(src + i);
+                if (d != known.end() && s != known.end())
+                    d->second = wrap(d->second + sign * s->second);
+                else
+                    known.erase(dst + i);
+            }
+        }
+
+        // the emitter may generate constants with multiplication loops, that leave 'size' cells at aux at zero
+        void clobber(cellReference aux, cellSize size = 1) {
+            for (cellSize c = 0; aux >= 0 && c < size; c++)
+                if (!isZero(aux + c, 1))
+                    known.erase(aux + c);
+        }
+
+        void rebase(cellReference offset) {
+            std::map<cellReference, cellValue> moved;
+            for (auto &k : known)
+                moved[k.first - offset] = k.second;
+            known.swap(moved);
+        }
+
+        void runOnFunction(CompilationState &state, FunctionSymbol &function) override {
+            vector<Instruction> out;
+            out.reserve(function.code.size());
+            known.clear();
+            range = state.cellRange();
+            for (auto i : function.code) {
+                switch (i.instr) {
+                    case InstructionName::LABEL:
+                        // the dispatcher leaves the matched address and two set flags in the registers
+                        known.clear();
+                        set(0, i.label.address);
+                        set(1, 1);
+                        set(2, 1);
+                        break;
+                    case InstructionName::ILOAD: {
+                        clobber(i.constant.aux, 2);
+                        auto k = known.find(i.constant.dst);
+                        if (k != known.end() && k->second == wrap(i.constant.value))
+                            continue;
+                        // adding the difference saves the clear, unless the difference is much larger than the value
+                        if (k != known.end() && cost(i.constant.value - k->second) < cost(i.constant.value) + 3) {
+                            i.instr = InstructionName::IADD;
+                            i.constant.value -= k->second;
+                            i.comment = i.comment.substr(0, i.comment.rfind(' ') + 1) + to_string(i.constant.value);
+                        }
+                        set(i.constant.dst, i.instr == InstructionName::ILOAD ? i.constant.value : k->second + i.constant.value);
+                        break;
+                    }
+                    case InstructionName::IADD:
+                    case InstructionName::ISUB: {
+                        clobber(i.constant.aux, 2);
+                        auto k = known.find(i.constant.dst);
+                        if (k != known.end())
+                            set(i.constant.dst, k->second + i.constant.value);
+                        break;
+                    }
+                    case InstructionName::MOVE:
+                    case InstructionName::ADD:
+                    case InstructionName::SUB:
+                        if (i.instr == InstructionName::MOVE && isZero(i.move.dst, i.move.size))
+                            i.instr = InstructionName::ADD;
+                        if (i.instr == InstructionName::MOVE)
+                            for (int c = 0; c < i.move.size; c++)
+                                set(i.move.dst + c, 0);
+                        add(i.move.dst, i.move.src, i.move.size, i.instr == InstructionName::SUB ? -1 : 1);
+                        for (int c = 0; c < i.move.size; c++)
+                            set(i.move.src + c, 0);
+                        break;
+                    case InstructionName::COPY:
+                    case InstructionName::ADD_COPY:
+                    case InstructionName::SUB_COPY:
+                        if (i.instr == InstructionName::COPY && isZero(i.copy.dst, i.copy.size))
+                            i.instr = InstructionName::ADD_COPY;
+                        if (i.instr == InstructionName::COPY)
+                            for (int c = 0; c < i.copy.size; c++)
+                                set(i.copy.dst + c, 0);
+                        add(i.copy.dst, i.copy.src, i.copy.size, i.instr == InstructionName::SUB_COPY ? -1 : 1);
+                        // only the first cell of the aux variable is used
+                        set(i.copy.aux, 0);
+                        break;
+                    case InstructionName::ADD_CARRY:
+                    case InstructionName::SUB_CARRY:
+                        for (int c = 0; c < i.copy.size; c++) {
+                            known.erase(i.copy.dst + c);
+                            set(i.copy.src + c, 0);
+                        }
+                        for (int c = 0; c < i.copy.size_aux; c++)
+                            set(i.copy.aux + c, 0);
+                        break;
+                    case InstructionName::IADD_CARRY:
+                        for (int c = 0; c < i.constant.size; c++)
+                            known.erase(i.constant.dst + c);
+                        for (int c = 0; c < 6; c++)
+                            set(i.constant.aux + c, 0);
+                        break;
+                    case InstructionName::MUL:
+                    case InstructionName::DIV:
+                    case InstructionName::MOD:
+                        known.erase(i.copy.dst);
+                        for (int c = 0; c < i.copy.size_aux; c++)
+                            set(i.copy.aux + c, 0);
+                        break;
+                    case InstructionName::LT:
+                    case InstructionName::LE:
+                    case InstructionName::GT:
+                    case InstructionName::GE:
+                    case InstructionName::EQ:
+                    case InstructionName::NE:
+                        // numbers of several cells leave the result in the first one
+                        known.erase(i.copy.dst);
+                        for (int c = 0; c < i.copy.size; c++) {
+                            if (c > 0)
+                                set(i.copy.dst + c, 0);
+                            set(i.copy.src + c, 0);
+                        }
+                        for (int c = 0; c < i.copy.size_aux; c++)
+                            set(i.copy.aux + c, 0);
+                        break;
+                    case InstructionName::IMUL:
+                        known.erase(i.constant.dst);
+                        set(i.constant.aux, 0);
+                        break;
+                    case InstructionName::IDIV:
+                    case InstructionName::IMOD:
+                        known.erase(i.constant.dst);
+                        for (int c = 0; c < 6; c++)
+                            set(i.constant.aux + c, 0);
+                        break;
+                    case InstructionName::DIVMOD:
+                        known.erase(i.copy.dst);
+                        known.erase(i.copy.dst + 1);
+                        for (int c = 0; c < i.copy.size_aux; c++)
+                            set(i.copy.aux + c, 0);
+                        break;
+                    case InstructionName::IDIVMOD:
+                        known.erase(i.constant.dst);
+                        known.erase(i.constant.dst + 1);
+                        for (int c = 0; c < 6; c++)
+                            set(i.constant.aux + c, 0);
+                        break;
+                    case InstructionName::COMPARE: {
+                        // the condition is known, if all of its cells are
+                        bool isKnown = true, notZero = false;
+                        for (int c = 0; c < i.compare.size; c++) {
+                            auto k = known.find(i.compare.conditionAddress + c);
+                            isKnown &= k != known.end();
+                            notZero |= k != known.end() && k->second != 0;
+                        }
+                        if (isKnown) {
+                            set(i.compare.isZero, !notZero);
+                            set(i.compare.notZero, notZero);
+                        } else {
+                            known.erase(i.compare.isZero);
+                            known.erase(i.compare.notZero);
+                        }
+                        for (int c = 0; c < i.compare.size; c++)
+                            set(i.compare.conditionAddress + c, 0);
+                        break;
+                    }
+                    case InstructionName::ARRAY_READ:
+                        set(i.array.index, 0);
+                        for (int c = 0; c < i.array.size; c++)
+                            known.erase(i.array.value + c);
+                        break;
+                    case InstructionName::ARRAY_WRITE:
+                        for (int c = 0; c < i.array.length; c++)
+                            known.erase(i.array.array + c);
+                        set(i.array.index, 0);
+                        for (int c = 0; c < i.array.size; c++)
+                            set(i.array.value + c, 0);
+                        break;
+                    case InstructionName::PUSH_STACK:
+                        rebase(i.stack.offset);
+                        break;
+                    case InstructionName::POP_STACK:
+                        rebase(-i.stack.offset);
+                        break;
+                    case InstructionName::WRITE_INPUT:
+                    case InstructionName::WRITE_DECIMAL_INPUT:
+                        for (int c = 0; c < i.io.size; c++)
+                            known.erase(i.io.src + c);
+                        for (int c = 0; c < i.io.size_aux; c++)
+                            set(i.io.aux + c, 0);
+                        break;
+                    case InstructionName::WRITE_DECIMAL_OUTPUT:
+                        for (int c = 0; c < i.io.size_aux; c++)
+                            set(i.io.aux + c, 0);
+                        break;
+                    case InstructionName::CALL:
+                        clobber(i.call.aux);
+                        set(i.call.returnCell, i.call.returnAddress);
+                        break;
+                    case InstructionName::WRITE_OUTPUT:
+                    case InstructionName::NOP:
+                        break;
+                    default:
+                        // the block ends or inline code may change any cell
+                        known.clear();
+                        break;
+                }
+                out.push_back(i);
+            }
+            function.code.swap(out);
+        }
+    };
+
+    // Removes directly adjacent pairs of '+-' and '<>'
+    struct CancelPass : Pass {
+        CancelPass() : Pass("cancel", 1) {}
+
+        void runOnBinary(const CompilationState &, std::string &binary) override {
+            std::string buffer;
+            buffer.reserve(binary.size());
+            for (char c : binary) {
+                if (!buffer.empty()
+                    && ((c == '+' && buffer.back() == '-')
+                        || (c == '-' && buffer.back() == '+')
+                        || (c == '>' && buffer.back() == '<')
+                        || (c == '<' && buffer.back() == '>')))
+                    // if the characters are opposites, remove both
+                    buffer.pop_back();
+                else
+                    buffer.push_back(c);
+            }
+            binary.swap(buffer);
+        }
+    };
+
+    // Rewrites straight-line brainfuck code between loops and io.
+    // Pending cell changes are collected per cell relative to the pointer, so that moves cancel across lines,
+    // successive clears merge and every cell is touched only once in order of the shortest pointer path.
+    // Cells with known values (e.g. after a loop) allow removing clears and loops, that can't be entered.
+    class Peephole {
+        struct Change {
+            // if set, the cell is overwritten with 'value', else 'value' is added to the cell
+            bool set;
+            long long value;
+        };
+
+        const std::string &in;
+        size_t pos = 0;
+        std::string out;
+        long long cellRange;
+        // offset of the logical pointer relative to the real pointer
+        int ptr = 0;
+        std::map<int, Change> pending;
+        std::map<int, long long> known;
+
+        long long wrap(long long value) const {
+            value %= cellRange;
+            return value < 0 ? value + cellRange : value;
+        }
+
+        // cost of adding 'delta' with '+' or '-'
+        long long addCost(long long delta) const {
+            delta = wrap(delta);
+            return std::min(delta, cellRange - delta);
+        }
+
+        void emitAdd(long long delta) {
+            delta = wrap(delta);
+            if (delta <= cellRange - delta)
+                out.append(static_cast<size_t>(delta), '+');
+            else
+                out.append(static_cast<size_t>(cellRange - delta), '-');
+        }
+
+        void emitMove(int from, int to) {
+            out.append(static_cast<size_t>(std::abs(to - from)), to > from ? '>' : '<');
+        }
+
+        void emitChange(int cell, const Change &change) {
+            auto k = known.find(cell);
+            if (!change.set) {
+                emitAdd(change.value);
+                if (k != known.end())
+                    k->second = wrap(k->second + change.value);
+                return;
+            }
+            long long target = wrap(change.value);
+            if (k != known.end() && addCost(target - k->second) <= 3 + addCost(target)) {
+                emitAdd(target - k->second);
+            } else {
+                out += "[-]";
+                emitAdd(target);
+            }
+            known[cell] = target;
+        }
+
+        // writes all pending changes and moves the real pointer to the logical pointer
+        void flush() {
+            int position = 0;
+            if (!pending.empty()) {
+                int lo = pending.begin()->first, hi = pending.rbegin()->first;
+                auto leftFirst = std::abs(lo) + (hi - lo) + std::abs(ptr - hi);
+                auto rightFirst = std::abs(hi) + (hi - lo) + std::abs(ptr - lo);
+                auto visit = [&](int cell, const Change &change) {
+                    emitMove(position, cell);
+                    position = cell;
+                    emitChange(cell, change);
+                };
+                if (leftFirst <= rightFirst)
+                    for (auto &c : pending) visit(c.first, c.second);
+                else
+                    for (auto c = pending.rbegin(); c != pending.rend(); ++c) visit(c->first, c->second);
+                pending.clear();
+            }
+            emitMove(position, ptr);
+            // the real pointer is now the origin
+            std::map<int, long long> rebased;
+            for (auto &k : known)
+                rebased[k.first - ptr] = k.second;
+            known.swap(rebased);
+            ptr = 0;
+        }
+
+        void add(long long value) {
+            auto c = pending.find(ptr);
+            if (c == pending.end())
+                pending[ptr] = Change{false, value};
+            else
+                c->second.value += value;
+        }
+
+        void clear() {
+            // a wide cell is cleared in as many steps as its value, so additions to an unknown value are kept
+            auto c = pending.find(ptr);
+            if (cellRange > 256 && c != pending.end() && !c->second.set && wrap(c->second.value) != 0
+                && known.count(ptr) == 0) {
+                flush();
+                out += "[-]";
+                known[0] = 0;
+                return;
+            }
+            pending[ptr] = Change{true, 0};
+        }
+
+        // skips the loop starting at pos
+        void skipLoop() {
+            int depth = 0;
+            do {
+                if (in[pos] == '[') ++depth;
+                else if (in[pos] == ']') --depth;
+                ++pos;
+            } while (depth != 0 && pos < in.size());
+        }
+
+        // optimizes until the end of the current loop
+        void block() {
+            while (pos < in.size()) {
+                char c = in[pos];
+                switch (c) {
+                    case '+': add(1); ++pos; break;
+                    case '-': add(-1); ++pos; break;
+                    case '>': ++ptr; ++pos; break;
+                    case '<': --ptr; ++pos; break;
+                    case '[': {
+                        if (in.compare(pos, 3, "[-]") == 0) {
+                            clear();
+                            pos += 3;
+                            break;
+                        }
+                        auto p = pending.find(ptr);
+                        auto k = known.find(ptr);
+                        if ((p != pending.end() && p->second.set && wrap(p->second.value) == 0)
+                            || (p == pending.end() && k != known.end() && k->second == 0)) {
+                            // loop on a zero cell is never entered
+                            skipLoop();
+                            break;
+                        }
+                        flush();
+                        out += '[';
+                        ++pos;
+                        known.clear();
+                        block();
+                        if (pos < in.size()) {
+                            flush();
+                            out += ']';
+                            ++pos;
+                        }
+                        // only the loop cell is known after leaving the loop
+                        known.clear();
+                        known[0] = 0;
+                        break;
+                    }
+                    case ']':
+                        return;
+                    default:
+                        flush();
+                        out += c;
+                        ++pos;
+                        if (c == ',')
+                            known.erase(0);
+                        else if (c != '.')
+                            known.clear();
+                        break;
+                }
+            }
+        }
+
+    public:
+        Peephole(const std::string &in, long long cellRange) : in(in), cellRange(cellRange) {}
+
+        std::string run() {
+            while (pos < in.size()) {
+                block();
+                flush();
+                if (pos < in.size()) {
+                    // unmatched loop end
+                    out += in[pos++];
+                    known.clear();
+                }
+            }
+            return out;
+        }
+    };
+
+    // Peephole optimization of the emitted brainfuck code
+    struct PeepholePass : Pass {
+        PeepholePass() : Pass("peephole", 2) {}
+
+        void runOnBinary(const CompilationState &state, std::string &binary) override {
+            binary = Peephole(binary, state.cellRange()).run();
+        }
+    };
+}
+
+void Pass::runOnProgram(CompilationState &state) {
+    for (auto fun : state.functions)
+        runOnFunction(state, *fun);
+}
+
+void PassManager::addDefaultPasses() {
+    add(new InlinePass);
+    add(new DeadCodePass);
+    add(new KnownValuePass);
+    add(new StackMergePass);
+    add(new CancelPass);
+    add(new PeepholePass);
+}
+
+void PassManager::run(CompilationState &state) {
+    for (auto &pass : passes) {
+        if (!isEnabled(*pass))
+            continue;
+        if (verbose)
+            println("Running pass:", pass->name);
+        pass->runOnProgram(state);
+    }
+}
+
+void PassManager::run(const CompilationState &state, std::string &binary) {
+    for (auto &pass : passes) {
+        if (!isEnabled(*pass))
+            continue;
+        pass->runOnBinary(state, binary);
+    }
+}
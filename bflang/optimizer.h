@@ -0,0 +1,52 @@
+//
+// Pass manager for the optimizations run between compilation and the final emission
+//
+
+#ifndef BFLANG_OPTIMIZER_H
+#define BFLANG_OPTIMIZER_H
+
+#include <set>
+#include "bf.h"
+
+// A single optimization, that is run on the compiled program before it is written
+struct Pass {
+    // name used by --disable-pass and the verbose output
+    std::string name;
+    // lowest optimization level, at which the pass is enabled
+    unsigned level;
+
+    Pass(std::string name, unsigned level) : name(std::move(name)), level(level) {}
+    virtual ~Pass() {}
+
+    // transforms the whole program; runs runOnFunction on every function by default
+    virtual void runOnProgram(CompilationState &state);
+
+    // transforms the instruction list of a single function
+    virtual void runOnFunction(CompilationState &, FunctionSymbol &) {}
+
+    // transforms the emitted brainfuck code
+    virtual void runOnBinary(const CompilationState &, std::string &) {}
+};
+
+struct PassManager {
+    unsigned level;
+    std::set<std::string> disabled;
+    vector<unique_ptr<Pass>> passes;
+
+    explicit PassManager(unsigned level) : level(level) {}
+
+    // registers all optimizations of the compiler in the order they are run
+    void addDefaultPasses();
+
+    void add(Pass *pass) { passes.emplace_back(pass); }
+
+    bool isEnabled(const Pass &pass) const { return pass.level <= level && disabled.count(pass.name) == 0; }
+
+    // runs all enabled passes on the instruction lists
+    void run(CompilationState &state);
+
+    // runs all enabled passes on the emitted brainfuck code
+    void run(const CompilationState &state, std::string &binary);
+};
+
+#endif //BFLANG_OPTIMIZER_H